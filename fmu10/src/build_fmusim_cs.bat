@@ -39,9 +39,9 @@ if defined VS80COMNTOOLS (call "%VS80COMNTOOLS%\vsvars32.bat") else ^
 goto noCompiler
 )
 
-set SRC=main.c ..\shared\xmlVersionParser.c ..\shared\parser\xml_parser.c ..\shared\parser\stack.c ..\shared\sim_support.c
+set SRC=main.c ..\shared\zipReader.c ..\shared\parser\xml_parser.c ..\shared\parser\stack.c ..\shared\sim_support.c
 set INC=/I../shared/include /I../shared/parser /I../shared /I.
-set OPTIONS=/DSTANDALONE_XML_PARSER /nologo /DFMI_COSIMULATION /DLIBXML_STATIC
+set OPTIONS=/DSTANDALONE_XML_PARSER /nologo /DFMI_COSIMULATION
 
 rem create fmusim_cs.exe in the fmusim_cs dir
 pushd co_simulation
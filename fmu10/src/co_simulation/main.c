@@ -17,11 +17,12 @@
  *
  * Revision history
  *  22.08.2011 initial version released in FMU SDK 1.0.2
+ *  18.10.2026 added option --output-format for binary result files
+ *  18.10.2026 added option --timing
  *
  * Free libraries and tools used to implement this simulator:
  *  - header files from the FMU specification
  *  - eXpat 2.0.1 XML parser, see http://expat.sourceforge.net
- *  - 7z.exe 4.57 zip and unzip tool, see http://www.7-zip.org
  * Author: Jakob Mauss
  * Copyright QTronic GmbH. All rights reserved.
  * -------------------------------------------------------------------------*/
@@ -35,7 +36,8 @@
 FMU fmu; // the fmu to simulate
 
 // simulate the given FMU from tStart = 0 to tEnd.
-static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char separator) {
+static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char separator,
+                    OutputFormat format, OutputFilter *filter) {
     double time;
     double tStart = 0;               // start time
     const char* guid;                // global unique id of the fmu
@@ -50,7 +52,7 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
     ModelDescription* md;            // handle to the parsed XML file
     int nSteps = 0;
     double hh = h;
-    FILE* file;
+    OutputWriter* writer;            // writes the result file
 
     // instantiate the fmu
     md = fmu->modelDescription;
@@ -63,21 +65,21 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
                               timeout, visible, interactive, callbacks, loggingOn);
     free(fmuLocation);
     if (!c) return error("could not instantiate model");
+    endPhase("instantiate");
 
     // open result file
-    if (!(file=fopen(RESULT_FILE, "w"))) {
-        printf("could not write %s because:\n", RESULT_FILE);
-        printf("    %s\n", strerror(errno));
+    if (!(writer = createOutputWriter(fmu, format, separator, filter))) {
         return 0; // failure
     }
+    endPhase("output");
 
     // StopTimeDefined=fmiFalse means: ignore value of tEnd
     fmiFlag = fmu->initializeSlave(c, tStart, fmiTrue, tEnd);
     if (fmiFlag > fmiWarning)  return error("could not initialize model");
+    endPhase("initialize");
     
     // output solution for time t0
-    outputRow(fmu, c, tStart, file, separator, fmiTrue);  // output column names
-    outputRow(fmu, c, tStart, file, separator, fmiFalse); // output values
+    if (!outputRow(fmu, c, writer, tStart)) return 0; // output values
 
     // enter the simulation loop
     time = tStart;
@@ -89,14 +91,16 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
         fmiFlag = fmu->doStep(c, time, hh, fmiTrue);
         if (fmiFlag != fmiOK)  return error("could not complete simulation of the model");
         time += hh;
-        outputRow(fmu, c, time, file, separator, fmiFalse); // output values for this step
+        if (!outputRow(fmu, c, writer, time)) return 0; // output values for this step
         nSteps++;
     }
+    endPhase("simulate");
 
     // end simulation
     fmiFlag = fmu->terminateSlave(c);
     fmu->freeSlaveInstance(c);
-    fclose(file);
+    closeOutputWriter(writer);
+    endPhase("terminate");
 
     // print simulation summary 
     printf("Simulation from %g to %g terminated successful\n", tStart, tEnd);
@@ -113,14 +117,37 @@ int main(int argc, char *argv[]) {
     double h=0.1;
     int loggingOn = 0;
     char csv_separator = ',';
-    parseArguments(argc, argv, &fmuFileName, &tEnd, &h, &loggingOn, &csv_separator);
-    loadFMU(fmuFileName);
+    SimOptions options = { NULL };
+    OutputFormat format = format_csv;
+    OutputFilter filter;
+    parseArguments(argc, argv, &fmuFileName, &tEnd, &h, &loggingOn, &csv_separator, &options);
+    if (!startTiming(options.timing)) {
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (options.outputFormat && !getOutputFormat(options.outputFormat, &format)) {
+        printf("error: The given output format (%s) is not known\n", options.outputFormat);
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    // the simulation starts at t = 0
+    if (!createOutputFilter(&options, 0, tEnd, &filter)) {
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    endPhase("options");
+    loadFMU(fmuFileName, options.cache, options.load);
 
     // run the simulation
     printf("FMU Simulator: run '%s' from t=0..%g with step size h=%g, loggingOn=%d, csv separator='%c'\n",
             fmuFileName, tEnd, h, loggingOn, csv_separator);
-    simulate(&fmu, tEnd, h, loggingOn, csv_separator);
-    printf("CSV file '%s' written\n", RESULT_FILE);
+    simulate(&fmu, tEnd, h, loggingOn, csv_separator, format, &filter);
+    if (format==format_csv) {
+        printf("CSV file '%s' written\n", RESULT_FILE);
+    }
+    else {
+        printf("Result file '%s' written\n", getResultFileName(format));
+    }
 
     // release FMU 
 #if WINDOWS
@@ -129,7 +156,10 @@ int main(int argc, char *argv[]) {
     dlclose(fmu.dllHandle);
 #endif /* WINDOWS */
     freeElement(fmu.modelDescription);
+    freeOutputFilter(&filter);
     deleteUnzippedFiles();
+    endPhase("release");
+    reportTiming(fmuFileName);
     return EXIT_SUCCESS;
 }
 
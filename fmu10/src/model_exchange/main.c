@@ -24,11 +24,12 @@
  *  31.07.2011 bug fix: added missing freeModelInstance(c)
  *  31.07.2011 bug fix: added missing terminate(c)
  *  30.08.2012 fixed access violation in xmlParser after reporting unknown attribute name
+ *  18.10.2026 added option --output-format for binary result files
+ *  18.10.2026 added option --timing
  *
  * Free libraries and tools used to implement this simulator:
  *  - header files from the FMU specification
  *  - eXpat 2.0.1 XML parser, see http://expat.sourceforge.net
- *  - 7z.exe 4.57 zip and unzip tool, see http://www.7-zip.org
  * Author: Jakob Mauss
  * Copyright QTronic GmbH. All rights reserved.
  * -------------------------------------------------------------------------*/
@@ -45,7 +46,8 @@ FMU fmu; // the fmu to simulate
 // time events are processed by reducing step size to exactly hit tNext.
 // state events are checked and fired only at the end of an Euler step. 
 // the simulator may therefore miss state events and fires state events typically too late.
-static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char separator) {
+static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char separator,
+                    OutputFormat format, OutputFilter *filter) {
     int i, n;
     double dt, tPre;
     fmiBoolean timeEvent, stateEvent, stepEvent;
@@ -68,7 +70,7 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
     int nTimeEvents = 0;
     int nStepEvents = 0;
     int nStateEvents = 0;
-    FILE* file;
+    OutputWriter* writer;            // writes the result file
 
     // instantiate the fmu
     md = fmu->modelDescription;
@@ -78,6 +80,7 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
     callbacks.freeMemory = free;
     c = fmu->instantiateModel(getModelIdentifier(md), guid, callbacks, loggingOn);
     if (!c) return error("could not instantiate model");
+    endPhase("instantiate");
 
     // allocate memory 
     nx = getNumberOfStates(md);
@@ -91,9 +94,7 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
     if ((!x || !xdot) || (nz>0 && (!z || !prez))) return error("out of memory");
 
     // open result file
-    if (!(file=fopen(RESULT_FILE, "w"))) {
-        printf("could not write %s because:\n", RESULT_FILE);
-        printf("    %s\n", strerror(errno));
+    if (!(writer = createOutputWriter(fmu, format, separator, filter))) {
         free(x);
         free(xdot);
         free(z);
@@ -101,6 +102,7 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
 
         return 0; // failure
     }
+    endPhase("output");
 
     // set the start time and initialize
     time = t0;
@@ -112,10 +114,10 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
         printf("model requested termination at init");
         tEnd = time;
     }
+    endPhase("initialize");
 
     // output solution for time t0
-    outputRow(fmu, c, t0, file, separator, fmiTrue);  // output column names
-    outputRow(fmu, c, t0, file, separator, fmiFalse); // output values
+    if (!outputRow(fmu, c, writer, t0)) return 0; // output values
 
     // enter the simulation loop
     while (time < tEnd) {
@@ -191,18 +193,20 @@ static int simulate(FMU* fmu, double tEnd, double h, fmiBoolean loggingOn, char
         }
 
      } // if event
-     outputRow(fmu, c, time, file, separator, fmiFalse); // output values for this step
+     if (!outputRow(fmu, c, writer, time)) return 0; // output values for this step
      nSteps++;
   } // while
+  endPhase("simulate");
 
   // cleanup
   if(! eventInfo.terminateSimulation) fmu->terminate(c);
   fmu->freeModelInstance(c);
-  fclose(file);
+  closeOutputWriter(writer);
   if (x!=NULL) free(x);
   if (xdot!= NULL) free(xdot);
   if (z!= NULL) free(z);
   if (prez!= NULL) free(prez);
+  endPhase("terminate");
 
   // print simulation summary 
   printf("Simulation from %g to %g terminated successful\n", t0, tEnd);
@@ -223,14 +227,37 @@ int main(int argc, char *argv[]) {
     double h=0.1;
     int loggingOn = 0;
     char csv_separator = ',';
-    parseArguments(argc, argv, &fmuFileName, &tEnd, &h, &loggingOn, &csv_separator);
-    loadFMU(fmuFileName);
+    SimOptions options = { NULL };
+    OutputFormat format = format_csv;
+    OutputFilter filter;
+    parseArguments(argc, argv, &fmuFileName, &tEnd, &h, &loggingOn, &csv_separator, &options);
+    if (!startTiming(options.timing)) {
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (options.outputFormat && !getOutputFormat(options.outputFormat, &format)) {
+        printf("error: The given output format (%s) is not known\n", options.outputFormat);
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    // the simulation starts at t = 0
+    if (!createOutputFilter(&options, 0, tEnd, &filter)) {
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    endPhase("options");
+    loadFMU(fmuFileName, options.cache, options.load);
 
     // run the simulation
     printf("FMU Simulator: run '%s' from t=0..%g with step size h=%g, loggingOn=%d, csv separator='%c'\n",
             fmuFileName, tEnd, h, loggingOn, csv_separator);
-    simulate(&fmu, tEnd, h, loggingOn, csv_separator);
-    printf("CSV file '%s' written\n", RESULT_FILE);
+    simulate(&fmu, tEnd, h, loggingOn, csv_separator, format, &filter);
+    if (format==format_csv) {
+        printf("CSV file '%s' written\n", RESULT_FILE);
+    }
+    else {
+        printf("Result file '%s' written\n", getResultFileName(format));
+    }
 
     // release FMU 
 #if WINDOWS
@@ -239,6 +266,9 @@ int main(int argc, char *argv[]) {
     dlclose(fmu.dllHandle);
 #endif /* WINDOWS */
     freeElement(fmu.modelDescription);
+    freeOutputFilter(&filter);
     deleteUnzippedFiles();
+    endPhase("release");
+    reportTiming(fmuFileName);
     return EXIT_SUCCESS;
 }
@@ -65,6 +65,7 @@ XML_Parser parser = NULL;    // non-NULL during parsing
 Stack* stack = NULL;         // the parser stack
 char* data = NULL;           // buffer that holds element content, see handleData
 int skipData=0;              // 1 to ignore element content, 0 when recording content
+int wrongVersion=0;          // 1 if parsing stopped at a model description of another FMI version
 
 // -------------------------------------------------------------------------
 // Low-level functions for inspecting the model description 
@@ -326,10 +327,65 @@ static int checkPointer(const void* ptr){
     return 1; // success
 }
 
-static int checkName(const char* name, const char* kind, const char* array[], int n){
+// Perfect hash of a table of names, e.g. attNames. The seed of the hash is searched when
+// the index is built such that no two names share a slot. A name is then looked up with
+// one hash and one strcmp instead of a strcmp with every name of the table.
+#define MAX_NAME_SLOTS 1024
+typedef struct {
+    const char** names;
+    int n;
+    int built;                           // 0 if not built yet, 1 if built, -1 if names are searched linearly
+    unsigned int seed;
+    unsigned int mask;                   // number of slots - 1
+    signed char slots[MAX_NAME_SLOTS];   // index in names or -1
+} NameIndex;
+
+static NameIndex elmIndex = { elmNames, SIZEOF_ELM, 0, 0, 0, {0} };
+static NameIndex attIndex = { attNames, SIZEOF_ATT, 0, 0, 0, {0} };
+static NameIndex enuIndex = { enuNames, SIZEOF_ENU, 0, 0, 0, {0} };
+
+static unsigned int hashName(const char* name, unsigned int seed){
+    unsigned int h = 2166136261u ^ seed; // FNV-1a
+    for (; *name; name++) h = (h ^ (unsigned char)*name) * 16777619u;
+    return h ^ (h >> 16);
+}
+
+// Returns 1 if the names fill the slots without collisions
+static int fillNameIndex(NameIndex* index){
+    int i;
+    memset(index->slots, -1, index->mask + 1);
+    for (i=0; i<index->n; i++) {
+        signed char* slot = &index->slots[hashName(index->names[i], index->seed) & index->mask];
+        if (*slot >= 0) return 0;
+        *slot = (signed char)i;
+    }
+    return 1;
+}
+
+// Returns 0 if the names do not fit into MAX_NAME_SLOTS slots without collisions
+static int buildNameIndex(NameIndex* index){
+    if (index->n > 128) return 0; // the slots hold the index of a name as signed char
+    for (index->mask = 1; index->mask < 2 * (unsigned int)index->n; index->mask *= 2);
+    index->mask--;
+    // try some seeds, double the number of slots if none of them is without collisions
+    for (; index->mask < MAX_NAME_SLOTS; index->mask = 2 * index->mask + 1) {
+        for (index->seed = 0; index->seed < 256; index->seed++) {
+            if (fillNameIndex(index)) return 1;
+        }
+    }
+    return 0;
+}
+
+static int checkName(const char* name, const char* kind, NameIndex* index){
     int i;
-    for (i=0; i<n; i++) {
-        if (!strcmp(name, array[i])) return i;
+    if (!index->built) index->built = buildNameIndex(index) ? 1 : -1;
+    if (index->built > 0) {
+        i = index->slots[hashName(name, index->seed) & index->mask];
+        if (i >= 0 && !strcmp(name, index->names[i])) return i;
+    } else {
+        for (i=0; i<index->n; i++) {
+            if (!strcmp(name, index->names[i])) return i;
+        }
     }
     logThis(ERROR_FATAL, "Illegal %s %s", kind, name);
     XML_StopParser(parser, XML_FALSE);
@@ -338,17 +394,17 @@ static int checkName(const char* name, const char* kind, const char* array[], in
 
 // Returns elm_BAD_DEFINED to indicate error
 static Elm checkElement(const char* elm){
-    return (Elm)checkName(elm, "element", elmNames, SIZEOF_ELM);
+    return (Elm)checkName(elm, "element", &elmIndex);
 }
 
 // Returns att_BAD_DEFINED to indicate error
 static Att checkAttribute(const char* att){
-    return (Att)checkName(att, "attribute", attNames, SIZEOF_ATT);
+    return (Att)checkName(att, "attribute", &attIndex);
 }
 
 // Returns enu_BAD_DEFINED to indicate error
 static Enu checkEnumValue(const char* enu){
-    return (Enu)checkName(enu, "enum value", enuNames, SIZEOF_ENU);
+    return (Enu)checkName(enu, "enum value", &enuIndex);
 }
 
 static void logFatalTypeError(const char* expected, Elm found) {
@@ -462,6 +518,21 @@ Element* newElement(Elm type, int size, const char** attr) {
     return e;
 }
 
+// Returns 0 if attribute fmiVersion of element fmiModelDescription
+// is missing or does not match FMI_XML_VERSION
+static int checkFmiVersion(const char** attr) {
+    int i;
+    for (i=0; attr[i]; i+=2) {
+        if (strcmp(attr[i], "fmiVersion")) continue;
+        if (strcmp(attr[i+1], FMI_XML_VERSION)==0) return 1;
+        logThis(ERROR_ERROR, "The FMU to simulate is FMI %s standard, but expected a FMI %s standard FMU",
+            attr[i+1], FMI_XML_VERSION);
+        return 0;
+    }
+    logThis(ERROR_ERROR, "The FMI version of the FMU could not be read");
+    return 0;
+}
+
 // -------------------------------------------------------------------------
 // callback functions called by the XML parser 
 
@@ -473,6 +544,12 @@ static void XMLCALL startElement(void *context, const char *elm, const char **at
     //logThis(ERROR_INFO, "start %s", elm);
     el = checkElement(elm);
     if (el==elm_BAD_DEFINED) return; // error
+    if (el==elm_fmiModelDescription && !checkFmiVersion(attr)) {
+        // the attributes of other versions are not known, stop here
+        wrongVersion = 1;
+        XML_StopParser(parser, XML_FALSE);
+        return;
+    }
     skipData = (el != elm_Name); // skip element content for all elements but Name
     switch(getAstNodeType(el)){
         case astElement:          size = sizeof(Element); break;
@@ -870,34 +947,51 @@ static void cleanup(FILE *file) {
     stack = NULL;
     XML_ParserFree(parser);
     parser = NULL;
-    fclose(file);
+    if (file) fclose(file);
 }
 
-ModelDescription* parse_encoding(const char* xmlPath, const char *encoding) {
+// parse the file at xmlPath, or the first size bytes of buffer if not NULL.
+// xmlPath is then the name of the buffer used in messages.
+static ModelDescription* parse_encoding(const char* xmlPath, const char* buffer, int size, const char *encoding) {
     ModelDescription* md = NULL;
-    FILE *file;
+    FILE *file = NULL;
     int done = 0;
+    wrongVersion = 0;
     stack = stackNew(100, 10);
     if (!checkPointer(stack)) return NULL; // failure
     parser = XML_ParserCreate(encoding);
     if (!checkPointer(parser)) return NULL; // failure
     XML_SetElementHandler(parser, startElement, endElement);
     XML_SetCharacterDataHandler(parser, handleData);
-    file = fopen(xmlPath, "rb");
-    if (file == NULL) {
-        logThis(ERROR_ERROR, "Cannot open file '%s'", xmlPath);
-        XML_ParserFree(parser);
-        return NULL; // failure
+    if (!buffer) {
+        file = fopen(xmlPath, "rb");
+        if (file == NULL) {
+            logThis(ERROR_ERROR, "Cannot open file '%s'", xmlPath);
+            XML_ParserFree(parser);
+            return NULL; // failure
+        }
     }
     logThis(ERROR_INFO, "parse %s", xmlPath);
     while (!done) {
-        int n = fread(text, sizeof(char), XMLBUFSIZE, file);
-        if (n != XMLBUFSIZE) done = 1;
-        if (!XML_Parse(parser, text, n, done)){
-            logThis(ERROR_ERROR, "Parse error in file %s at line %d:\n%s\n",
-                xmlPath,
-                XML_GetCurrentLineNumber(parser),
-                XML_ErrorString(XML_GetErrorCode(parser)));
+        int n;
+        const char *chunk;
+        if (buffer) {
+            // the whole buffer in one go
+            chunk = buffer;
+            n = size;
+            done = 1;
+        } else {
+            chunk = text;
+            n = fread(text, sizeof(char), XMLBUFSIZE, file);
+            if (n != XMLBUFSIZE) done = 1;
+        }
+        if (!XML_Parse(parser, chunk, n, done)){
+            if (!wrongVersion) { // else reported by checkFmiVersion
+                logThis(ERROR_ERROR, "Parse error in file %s at line %d:\n%s\n",
+                    xmlPath,
+                    XML_GetCurrentLineNumber(parser),
+                    XML_ErrorString(XML_GetErrorCode(parser)));
+            }
             while (!stackIsEmpty(stack)) md = (ModelDescription *)stackPop(stack);
             if (md) freeElement(md);
             cleanup(file);
@@ -911,26 +1005,23 @@ ModelDescription* parse_encoding(const char* xmlPath, const char *encoding) {
     return validate(md); // success if all refs are valid
 }
 
-// Returns NULL to indicate failure
-// Otherwise, return the root node md of the AST.
-// The receiver must call freeElement(md) to release AST memory.
-ModelDescription* parse(const char* xmlPath) {
+static ModelDescription* parse_buffer_or_file(const char* xmlPath, const char* buffer, int size) {
     // UTF-8
     // ISO-8859-1
     // US-ASCII
     // UTF-16
     ModelDescription* md = NULL;
-    md = parse_encoding(xmlPath, "UTF-8");
-    if (md != NULL) {
+    md = parse_encoding(xmlPath, buffer, size, "UTF-8");
+    if (md != NULL || wrongVersion) {
         return md;
     }
     logThis(ERROR_WARNING, "Failed to parse using UTF-8, will try ISO-8859-1 encoding. %s", xmlPath);
-    md = parse_encoding(xmlPath, "ISO-8859-1");
+    md = parse_encoding(xmlPath, buffer, size, "ISO-8859-1");
     if (md != NULL) {
         return md;
     }
     logThis(ERROR_WARNING, "Failed to parse using ISO-8859-1, will try US-ASCII encoding. %s", xmlPath);
-    md = parse_encoding(xmlPath, "US-ASCII");
+    md = parse_encoding(xmlPath, buffer, size, "US-ASCII");
     if (md != NULL) {
         return md;
     }
@@ -938,6 +1029,19 @@ ModelDescription* parse(const char* xmlPath) {
     return NULL;
 }
 
+// Returns NULL to indicate failure
+// Otherwise, return the root node md of the AST.
+// The receiver must call freeElement(md) to release AST memory.
+ModelDescription* parse(const char* xmlPath) {
+    return parse_buffer_or_file(xmlPath, NULL, 0);
+}
+
+// Same as parse, for the model description in the first size bytes of buffer,
+// e.g. read from the FMU archive. name is used in messages.
+ModelDescription* parseBuffer(const char* buffer, int size, const char* name) {
+    return parse_buffer_or_file(name, buffer, size);
+}
+
 // #define TEST
 #ifdef TEST
 int main(int argc, char**argv) {
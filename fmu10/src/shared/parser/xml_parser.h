@@ -144,8 +144,13 @@ typedef enum {
     valueIllegal
 } ValueStatus;
 
+// the value of attribute fmiVersion accepted by the parser
+#define FMI_XML_VERSION "1.0"
+
 // Public methods: Parsing and low-level AST access
+// Both fail if the model description is not of FMI_XML_VERSION.
 ModelDescription* parse(const char* xmlPath);
+ModelDescription* parseBuffer(const char* buffer, int size, const char* name);
 const char* getString(void* element, Att a);
 double getDouble     (void* element, Att a, ValueStatus* vs);
 int getInt           (void* element, Att a, ValueStatus* vs);
@@ -3,14 +3,33 @@
  * Functions used by both FMU simulators fmu10sim_me and fmu10sim_cs
  * to parse command-line arguments, to unzip and load an fmu, 
  * to write CSV file, and more.
+ *
+ * Revision history
+ *  18.10.2026 write the result through an output writer: CSV, MAT v4 or raw binary.
+ *  18.10.2026 format and write the result in a background thread.
+ *  18.10.2026 write reals in CSV files in the shortest form that reads back exactly.
+ *  18.10.2026 filter the written variables by name and causality, decimate or
+ *             downsample the written rows.
+ *  18.10.2026 keep unzipped FMUs in a cache shared by all runs.
+ *  18.10.2026 optionally load the FMU binary from memory on Linux.
+ *  18.10.2026 report the time of the phases of a run, option --timing.
+ *
  * Copyright QTronic GmbH. All rights reserved.
  * -------------------------------------------------------------------------*/
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  // memfd_create()
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <float.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>  // clock_gettime()
 
 #ifdef FMI_COSIMULATION
 #include "fmi_cs.h"
@@ -18,88 +37,73 @@
 #include "fmi_me.h"
 #endif
 
-#include "xmlVersionParser.h"
+#include "zipReader.h"
 #include "sim_support.h"
 
 #if !WINDOWS
 #define MAX_PATH 1024
 #include <unistd.h>  // mkdtemp()
 #include <dlfcn.h> //dlsym()
+#include <fcntl.h>  // fcntl()
+#include <sys/stat.h>  // mkdir()
+#include <ftw.h>  // nftw()
+#endif /* WINDOWS */
+#ifdef __linux__
+#include <sys/mman.h>  // memfd_create()
+#endif /* __linux__ */
+
+#if WINDOWS
+#define PATH_SEPARATOR "\\"
+#else /* WINDOWS */
+#define PATH_SEPARATOR "/"
 #endif /* WINDOWS */
 
+// name of the cache directory in the default location, see getDefaultCacheDir()
+#define CACHE_DIR_NAME "fmusim"
+
 extern FMU fmu;
 
-#if WINDOWS
-int unzip(const char *zipPath, const char *outPath) {
-    int code;
-    char binPath[BUFSIZE];
-    int n = BUFSIZE + strlen(UNZIP_CMD) + strlen(outPath) + 3 +  strlen(zipPath) + 9;
-    char* cmd = (char*)calloc(sizeof(char), n);
+static char *fmuDirectory = NULL;  // directory of the extracted FMU, ends with a separator
+static int fmuCached = 0;          // fmuDirectory is in the cache and kept after the run
 
-    // %FMUSDK_HOME%\bin to find 7z.dll and 7z.exe
-    if (!GetEnvironmentVariable("FMUSDK_HOME", binPath, BUFSIZE)) {
-        if (GetLastError() == ERROR_ENVVAR_NOT_FOUND) {
-            printf ("error: Environment variable FMUSDK_HOME not defined\n");
-        }
-        else {
-            printf ("error: Could not get value of FMUSDK_HOME\n");
-        }
-        return 0; // error
-    }
-    strcat(binPath, "\\fmu10\\bin");
-    // run the unzip command
-    // remove "> NUL" to see the unzip protocol
-    sprintf(cmd, "%s\\%s\"%s\" \"%s\" > NUL", binPath, UNZIP_CMD, outPath, zipPath);
-    // printf("cmd='%s'\n", cmd);
-    code = system(cmd);
-    free(cmd);
-    if (code!=SEVEN_ZIP_NO_ERROR) {
-        printf("7z: ");
-        switch (code) {
-            case SEVEN_ZIP_WARNING:            printf("warning\n"); break;
-            case SEVEN_ZIP_ERROR:              printf("error\n"); break;
-            case SEVEN_ZIP_COMMAND_LINE_ERROR: printf("command line error\n"); break;
-            case SEVEN_ZIP_OUT_OF_MEMORY:      printf("out of memory\n"); break;
-            case SEVEN_ZIP_STOPPED_BY_USER:    printf("stopped by user\n"); break;
-            default: printf("unknown problem\n");
-        }
+// 1 if the path in the archive starts with dir, a directory of the file system
+// that may use '\\' as separator
+static int isInDirectory(const char *path, const char *dir) {
+    for (; *dir; dir++, path++) {
+        if (*path!=(*dir=='\\' ? '/' : *dir)) return 0;
     }
+    return 1;
+}
 
-    return (code==SEVEN_ZIP_NO_ERROR || code==SEVEN_ZIP_WARNING) ? 1 : 0;
+// 1 if the entry is needed on disk to simulate the FMU: the model description and
+// the binaries for this platform, unless the binary is loaded from memory, and the resources
+static int isExtracted(const char *name, int withBinaries) {
+    return (withBinaries && (strcmp(name, XML_FILE)==0 || isInDirectory(name, DLL_DIR)))
+        || isInDirectory(name, "resources/");
 }
 
-#else /* WINDOWS */
+// number of entries of the archive to extract
+static int countExtracted(ZipArchive *zip, int withBinaries) {
+    int i;
+    int n = 0;
+    for (i=0; i<zip->nEntries; i++) {
+        if (isExtracted(zip->entries[i].name, withBinaries)) n++;
+    }
+    return n;
+}
 
-int unzip(const char *zipPath, const char *outPath) {
-    int code;
-    int n;
-    char* cmd;
-
-    // run the unzip command
-    n = strlen(UNZIP_CMD) + strlen(outPath) + 1 +  strlen(zipPath) + 16;
-    cmd = (char*)calloc(sizeof(char), n);
-    sprintf(cmd, "%s%s \"%s\" > /dev/null", UNZIP_CMD, outPath, zipPath);
-    printf("cmd='%s'\n", cmd);
-    code = system(cmd);
-    free(cmd);
-    if (code!=SEVEN_ZIP_NO_ERROR) {
-        printf("%s: ", UNZIP_CMD);
-        switch (code) {
-            case 1:            printf("warning\n"); break;
-            case 2:            printf("error\n"); break;
-            case 3:            printf("severe error\n"); break;
-            case 4:
-            case 5:
-            case 6:
-            case 7:
-                               printf("out of memory\n"); break;
-            case 10:           printf("command line error\n"); break;
-            default:           printf("unknown problem %d\n", code);
-        }
-    }
-    return (code==SEVEN_ZIP_NO_ERROR || code==SEVEN_ZIP_WARNING) ? 1 : 0;
+// extract the entries needed to simulate the FMU: the model description and the
+// binaries for this platform if withBinaries, and the resources. Return 0 on errors.
+int unzip(ZipArchive *zip, const char *outPath, int withBinaries) {
+    int i;
+    int ok = 1;
+    for (i=0; ok && i<zip->nEntries; i++) {
+        if (isExtracted(zip->entries[i].name, withBinaries)) {
+            ok = extractZipEntry(zip, i, outPath);
+        }
+    }
+    return ok;
 }
-#endif /* WINDOWS */
 
 #if WINDOWS
 // fileName is an absolute path, e.g. C:\test\a.fmu
@@ -128,27 +132,281 @@ static char* getFmuPath(const char* fmuFileName){
   /* Not sure why this is useful.  Just returning the filename. */
   return strdup(fmuFileName);
 }
+// the directory is created on the first call, later calls return the same path
 static char* getTmpPath() {
-  char template[13];  // Lenght of "fmuTmpXXXXXX" + null
-  sprintf(template, "%s", "fmuTmpXXXXXX");
-  //char *tmp = mkdtemp(strdup("fmuTmpXXXXXX"));
-  char *tmp = mkdtemp(template);
-  if (tmp==NULL) {
-    fprintf(stderr, "Couldn't create temporary directory\n");
-    exit(1);
+  static char template[14] = "";  // "fmuTmpXXXXXX/" + null
+  if (template[0]=='\0') {
+    strcpy(template, "fmuTmpXXXXXX");
+    if (mkdtemp(template)==NULL) {
+      fprintf(stderr, "Couldn't create temporary directory\n");
+      exit(1);
+    }
+    strcat(template, "/");
   }
-  char * results = calloc(sizeof(char), strlen(tmp) + 2);
-  strncat(results, tmp, strlen(tmp));
-  return strcat(results, "/");
+  return strdup(template);
+}
+#endif /* WINDOWS */
+
+#if WINDOWS
+typedef HANDLE FileLock;
+#define NO_FILE_LOCK INVALID_HANDLE_VALUE
+
+static int isDirectory(const char *path) {
+    DWORD attributes = GetFileAttributes(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+static int makeDirectory(const char *path) {
+    return CreateDirectory(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+// wait until this process holds the lock on the file at path
+static FileLock lockFile(const char *path) {
+    OVERLAPPED overlapped;
+    HANDLE file = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NO_FILE_LOCK;
+    memset(&overlapped, 0, sizeof(overlapped));
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped)) {
+        CloseHandle(file);
+        return NO_FILE_LOCK;
+    }
+    return file;
+}
+
+static void unlockFile(FileLock lock) {
+    CloseHandle(lock); // releases the lock
+}
+
+static char *getDefaultCacheDir() {
+    char tmpPath[BUFSIZE];
+    if (!GetTempPath(BUFSIZE, tmpPath)) return NULL;
+    strcat(tmpPath, CACHE_DIR_NAME "\\");
+    return strdup(tmpPath);
+}
+
+// absolute path of the existing directory dir, ends with a separator
+static char *getAbsoluteDirectory(const char *dir) {
+    char path[MAX_PATH];
+    int n = GetFullPathName(dir, MAX_PATH - 1, path, NULL);
+    if (!n || n >= MAX_PATH - 1) return NULL;
+    if (path[n - 1] != '\\') strcat(path, "\\");
+    return strdup(path);
+}
+
+#else /* WINDOWS */
+typedef int FileLock;
+#define NO_FILE_LOCK -1
+
+static int isDirectory(const char *path) {
+    struct stat status;
+    return stat(path, &status) == 0 && S_ISDIR(status.st_mode);
+}
+
+static int makeDirectory(const char *path) {
+    return mkdir(path, 0777) == 0 || errno == EEXIST;
+}
+
+// wait until this process holds the lock on the file at path
+static FileLock lockFile(const char *path) {
+    struct flock lock;
+    int file = open(path, O_RDWR | O_CREAT, 0666);
+    if (file == -1) return NO_FILE_LOCK;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(file, F_SETLKW, &lock) == -1) {
+        if (errno != EINTR) {
+            close(file);
+            return NO_FILE_LOCK;
+        }
+    }
+    return file;
+}
+
+static void unlockFile(FileLock lock) {
+    close(lock); // releases the lock
+}
+
+// $XDG_CACHE_HOME/fmusim/ or ~/.cache/fmusim/
+static char *getDefaultCacheDir() {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char *cacheDir;
+    if ((!base || !*base) && (!home || !*home)) return NULL;
+    cacheDir = (char *)calloc(strlen(base && *base ? base : home) + strlen(CACHE_DIR_NAME) + 10, sizeof(char));
+    if (!cacheDir) return NULL;
+    if (base && *base) sprintf(cacheDir, "%s/%s/", base, CACHE_DIR_NAME);
+    else sprintf(cacheDir, "%s/.cache/%s/", home, CACHE_DIR_NAME);
+    return cacheDir;
+}
+
+// absolute path of the existing directory dir, ends with a separator
+static char *getAbsoluteDirectory(const char *dir) {
+    char *path = realpath(dir, NULL);
+    char *result;
+    if (!path) return NULL;
+    result = (char *)calloc(strlen(path) + 2, sizeof(char));
+    if (result) sprintf(result, "%s/", path);
+    free(path);
+    return result;
 }
 #endif /* WINDOWS */
 
+// delete the directory path and everything in it. Runs no shell, path may contain any character.
+#if WINDOWS
+static void removeDirectory(const char *path) {
+    size_t n = strlen(path);
+    char *pattern;
+    WIN32_FIND_DATA data;
+    HANDLE find;
+    while (n > 0 && (path[n - 1] == '\\' || path[n - 1] == '/')) n--;
+    pattern = (char *)malloc(n + 3);
+    if (!pattern) return;
+    sprintf(pattern, "%.*s\\*", (int)n, path);
+    find = FindFirstFile(pattern, &data);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            char *child;
+            if (!strcmp(data.cFileName, ".") || !strcmp(data.cFileName, "..")) continue;
+            child = (char *)malloc(n + strlen(data.cFileName) + 2);
+            if (!child) continue;
+            sprintf(child, "%.*s\\%s", (int)n, path, data.cFileName);
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+                // a link, delete the link but not its target
+                if (!RemoveDirectory(child)) DeleteFile(child);
+            } else if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                removeDirectory(child);
+            } else {
+                SetFileAttributes(child, FILE_ATTRIBUTE_NORMAL);  // DeleteFile fails on read-only files
+                DeleteFile(child);
+            }
+            free(child);
+        } while (FindNextFile(find, &data));
+        FindClose(find);
+    }
+    pattern[n] = '\0';
+    RemoveDirectory(pattern);
+    free(pattern);
+}
+#else /* WINDOWS */
+// called by nftw for every entry, the content of a directory before the directory
+static int removeEntry(const char *path, const struct stat *status, int type, struct FTW *ftw) {
+    (void)status;
+    (void)type;
+    (void)ftw;
+    remove(path);
+    return 0;  // continue with the other entries
+}
+
+static void removeDirectory(const char *path) {
+    // FTW_PHYS: delete symbolic links, not their targets
+    nftw(path, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+#endif /* WINDOWS */
+
+// create path and its missing parents
+static int makeDirectories(const char *path) {
+    char *copy = strdup(path);
+    char *p;
+    int ok;
+    if (!copy) return 0;
+    for (p = copy + 1; *p; p++) {
+        if ((*p == '/' || *p == '\\') && p[-1] != ':') {
+            char c = *p;
+            *p = '\0';
+            makeDirectory(copy);
+            *p = c;
+        }
+    }
+    ok = makeDirectory(copy);
+    free(copy);
+    return ok;
+}
+
+// 64 bit FNV-1a hash of the archive, the key of its extraction in the cache
+static unsigned long long hashArchive(ZipArchive *zip) {
+    unsigned long long hash = 14695981039346656037ULL;
+    size_t i;
+    for (i = 0; i < zip->size; i++) {
+        hash ^= zip->data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Return the directory of the FMU in the cache, extract it there if this is the
+// first run of the archive. The directory is named after the hash and size of the
+// archive, so a changed FMU gets a new directory, and ends with -r if it holds only
+// the resources because the binaries are loaded from memory. A lock file serializes the
+// extraction by concurrent simulators, the extraction is moved into place when
+// complete, so a crash never leaves a partial directory. Return NULL on errors.
+static char *getCachedFmu(ZipArchive *zip, const char *cacheDir, int withBinaries) {
+    char *root = strcmp(cacheDir, "on") != 0 ? strdup(cacheDir) : getDefaultCacheDir();
+    char *path, *tmpPath, *lockPath;
+    size_t n;
+    FileLock lock;
+    int ok = 1;
+
+    if (!root) {
+        printf("error: Could not find a directory for the FMU cache, see option --cache\n");
+        return NULL;
+    }
+    n = strlen(root);
+    path = (char *)calloc(n + 64, sizeof(char)); // hash, size, separator and ".lock"
+    tmpPath = (char *)calloc(n + 64, sizeof(char));
+    lockPath = (char *)calloc(n + 64, sizeof(char));
+    if (!path || !tmpPath || !lockPath) {
+        free(root);
+        free(path);
+        free(tmpPath);
+        free(lockPath);
+        printf("error: out of memory\n");
+        return NULL;
+    }
+    sprintf(path, "%s%s%016llx-%lu%s", root, n > 0 && (root[n - 1] == '/' || root[n - 1] == '\\') ? "" : PATH_SEPARATOR,
+            hashArchive(zip), (unsigned long)zip->size, withBinaries ? "" : "-r");
+    sprintf(tmpPath, "%s.tmp", path);
+    sprintf(lockPath, "%s.lock", path);
+
+    if (!isDirectory(path)) {
+        if (!makeDirectories(root) || (lock = lockFile(lockPath)) == NO_FILE_LOCK) {
+            printf("error: Could not lock %s\n", lockPath);
+            ok = 0;
+        } else {
+            // another simulator may have extracted the FMU while this one waited for the lock
+            if (!isDirectory(path)) {
+                size_t m = strlen(tmpPath);
+                removeDirectory(tmpPath); // left by a crashed extraction
+                tmpPath[m] = PATH_SEPARATOR[0];
+                ok = makeDirectory(tmpPath) && unzip(zip, tmpPath, withBinaries);
+                tmpPath[m] = '\0';
+                if (ok && rename(tmpPath, path) != 0) {
+                    printf("error: Could not move %s to %s\n", tmpPath, path);
+                    ok = 0;
+                }
+                if (!ok) removeDirectory(tmpPath);
+            }
+            unlockFile(lock);
+        }
+    }
+    free(root);
+    free(tmpPath);
+    free(lockPath);
+    if (!ok) {
+        free(path);
+        return NULL;
+    }
+    strcat(path, PATH_SEPARATOR);
+    return path;
+}
+
 char *getTempFmuLocation() {
-    char *tempPath = getTmpPath();
-    char *fmuLocation = (char *)calloc(sizeof(char), 8 + strlen(tempPath));
+    char *fmuLocation;
+    if (!fmuDirectory) return NULL; // nothing extracted, the binary is loaded from memory
+    fmuLocation = (char *)calloc(sizeof(char), 8 + strlen(fmuDirectory));
     strcpy(fmuLocation, "file://");
-    strcat(fmuLocation, tempPath);
-    free(tempPath);
+    strcat(fmuLocation, fmuDirectory);
     return fmuLocation;
 }
 
@@ -243,6 +501,48 @@ static int loadDll(const char* dllPath, FMU *fmu) {
     return s; 
 }
 
+#ifdef __linux__
+// Load the binary dllName of the archive without extracting it: it is written
+// to an anonymous memory file, that is loaded through /proc/self/fd.
+// Return 0 on errors.
+static int loadDllFromArchive(ZipArchive *zip, const char *dllName, const char *modelId, FMU *fmu) {
+    char procPath[64];
+    unsigned char *data;
+    size_t size;
+    size_t written = 0;
+    int fd, ok;
+    int i = findZipEntry(zip, dllName);
+    if (i < 0) {
+        printf("error: %s not found in the FMU\n", dllName);
+        return 0;
+    }
+    data = readZipEntry(zip, i, &size);
+    if (!data) return 0;
+    fd = memfd_create(modelId, MFD_CLOEXEC);
+    if (fd == -1) {
+        printf("error: Could not create a memory file for %s: %s\n", dllName, strerror(errno));
+        free(data);
+        return 0;
+    }
+    while (written < size) {
+        ssize_t n = write(fd, data + written, size - written);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += (size_t)n;
+    }
+    free(data);
+    if (written < size) {
+        printf("error: Could not write %s to a memory file: %s\n", dllName, strerror(errno));
+        close(fd);
+        return 0;
+    }
+    sprintf(procPath, "/proc/self/fd/%d", fd);
+    ok = loadDll(procPath, fmu);
+    close(fd); // the library keeps its mapping of the memory file
+    return ok;
+}
+#endif /* __linux__ */
+
 static void printModelDescription(ModelDescription* md){
     Element* e = (Element*)md;  
     int i;
@@ -261,169 +561,1362 @@ static void printModelDescription(ModelDescription* md){
 #endif // FMI_COSIMULATION  
 }
 
-void loadFMU(const char* fmuFileName) {
+void loadFMU(const char* fmuFileName, const char *cacheDir, const char *load) {
     char* fmuPath;
-    char* tmpPath;
+    char* tmpPath = NULL;
+    ZipArchive *zip;
+    int i;
+    char* xml;
+    size_t xmlSize;
     char* xmlPath;
     char* dllPath;
-    
+    const char *modelId;
+    int inMemory = load && strcmp(load, "memory")==0;
+
+    if (load && !inMemory && strcmp(load, "file")!=0) {
+        printf("error: Unknown value of option --load: %s\n", load);
+        exit(EXIT_FAILURE);
+    }
+#ifndef __linux__
+    if (inMemory) {
+        printf("error: --load=memory is only supported on Linux\n");
+        exit(EXIT_FAILURE);
+    }
+#endif /* __linux__ */
+
     // get absolute path to FMU, NULL if not found
     fmuPath = getFmuPath(fmuFileName);
     if (!fmuPath) exit(EXIT_FAILURE);
+    zip = openZipArchive(fmuPath);
+    if (!zip) exit(EXIT_FAILURE);
+    endPhase("open");
 
-    // unzip the FMU to the tmpPath directory
-    tmpPath = getTmpPath();
-    if (!unzip(fmuPath, tmpPath)) exit(EXIT_FAILURE);
-
-    // parse tmpPath\modelDescription.xml
-    xmlPath = calloc(sizeof(char), strlen(tmpPath) + strlen(XML_FILE) + 1);
-    sprintf(xmlPath, "%s%s", tmpPath, XML_FILE);
-
-    // parse tmpPath\modelDescription.xml
-    xmlPath = calloc(sizeof(char), strlen(tmpPath) + strlen(XML_FILE) + 1);
-    sprintf(xmlPath, "%s%s", tmpPath, XML_FILE);
-    // check FMI version of the FMU to match current simulator version
-    if (!checkFmiVersion(xmlPath)) {
-        free(xmlPath);
-        free(fmuPath);
-        free(tmpPath);
+    // read modelDescription.xml from the archive, it is parsed in memory.
+    // The name used in messages is fmuPath/modelDescription.xml
+    xmlPath = calloc(sizeof(char), strlen(fmuPath) + strlen(XML_FILE) + 2);
+    sprintf(xmlPath, "%s/%s", fmuPath, XML_FILE);
+    i = findZipEntry(zip, XML_FILE);
+    if (i < 0) printf("error: %s not found in %s\n", XML_FILE, fmuPath);
+    xml = i < 0 ? NULL : (char *)readZipEntry(zip, i, &xmlSize);
+    if (!xml) {
+        closeZipArchive(zip);
         exit(EXIT_FAILURE);
     }
-
-    fmu.modelDescription = parse(xmlPath);
+    // the parser checks that the FMI version matches this simulator
+    fmu.modelDescription = parseBuffer(xml, (int)xmlSize, xmlPath);
+    free(xml);
     free(xmlPath);
     if (!fmu.modelDescription) exit(EXIT_FAILURE);
+    endPhase("parse");
     printModelDescription(fmu.modelDescription);
+    endPhase("print");
+    modelId = getModelIdentifier(fmu.modelDescription);
+
+    // unzip the FMU to the tmpPath directory, or find it unzipped in the cache.
+    // Nothing is unzipped if the binary is loaded from memory and there are no resources.
+    if (!inMemory || countExtracted(zip, 0) > 0) {
+        fmuCached = cacheDir && strcmp(cacheDir, "off")!=0;
+        if (fmuCached) {
+            tmpPath = getCachedFmu(zip, cacheDir, !inMemory);
+        } else if ((tmpPath = getTmpPath()) && !unzip(zip, tmpPath, !inMemory)) {
+            free(tmpPath);
+            tmpPath = NULL;
+        }
+        if (!tmpPath) exit(EXIT_FAILURE);
+        // the location given to the FMU is an URI, so it needs the absolute path
+        fmuDirectory = getAbsoluteDirectory(tmpPath);
+        if (!fmuDirectory) {
+            printf("error: Could not find directory %s\n", tmpPath);
+            exit(EXIT_FAILURE);
+        }
+    }
+    endPhase("unzip");
 
     // load the FMU dll
-    dllPath = calloc(sizeof(char), strlen(tmpPath) + strlen(DLL_DIR)
-            + strlen( getModelIdentifier(fmu.modelDescription)) +  strlen(DLL_SUFFIX) + 1);
-    sprintf(dllPath,"%s%s%s%s", tmpPath, DLL_DIR, getModelIdentifier(fmu.modelDescription), DLL_SUFFIX);
+    if (inMemory) {
+        dllPath = calloc(sizeof(char), strlen(DLL_DIR) + strlen(modelId) + strlen(DLL_SUFFIX) + 1);
+        sprintf(dllPath,"%s%s%s", DLL_DIR, modelId, DLL_SUFFIX);
+    } else {
+        dllPath = calloc(sizeof(char), strlen(tmpPath) + strlen(DLL_DIR)
+                + strlen(modelId) +  strlen(DLL_SUFFIX) + 1);
+        sprintf(dllPath,"%s%s%s%s", tmpPath, DLL_DIR, modelId, DLL_SUFFIX);
+    }
+#ifdef __linux__
+    if (inMemory ? !loadDllFromArchive(zip, dllPath, modelId, &fmu) : !loadDll(dllPath, &fmu)) {
+#else /* __linux__ */
     if (!loadDll(dllPath, &fmu)) {
+#endif /* __linux__ */
+        closeZipArchive(zip);
         free(dllPath);
         free(fmuPath);
         free(tmpPath);
         exit(EXIT_FAILURE);
     }
+    closeZipArchive(zip);
     free(dllPath);
     free(fmuPath);
     free(tmpPath);
+    endPhase("load");
 }
 
-int checkFmiVersion(const char *xmlPath) {
-    char *xmlFmiVersion = extractVersion(xmlPath);
-    if (xmlFmiVersion == NULL) {
-        printf("The FMI version of the FMU could not be read: %s", xmlPath);
-        return 0;
-    } else if (strcmp(xmlFmiVersion, fmiVersion) == 0) {
-        free(xmlFmiVersion);
-        return 1;
-    }
-    printf("The FMU to simulate is FMI %s standard, but expected a FMI %s standard FMU", fmiVersion, xmlFmiVersion);
-    free(xmlFmiVersion);
-    return 0;
+void deleteUnzippedFiles() {
+    // the cache keeps the files for the next run
+    if (fmuDirectory && !fmuCached) removeDirectory(fmuDirectory);
+    free(fmuDirectory);
+    fmuDirectory = NULL;
 }
 
-void deleteUnzippedFiles() {
-    char *fmuTempPath = getTmpPath();
-    char *cmd = (char *)calloc(15 + strlen(fmuTempPath), sizeof(char));
+// timing of the phases of a run, see option --timing
+#define MAX_PHASES 16
+#define TIMING_DOTS "................."  // 17, phase names are shorter
+
+typedef struct {
+    const char *name;
+    double seconds;
+} Phase;
+
+static int timingMode = 0;        // 0: off, 1: print the phases, 2: write them to TIMING_FILE
+static double timingStart;        // time of startTiming()
+static double phaseStart;         // time of the end of the previous phase
+static Phase phases[MAX_PHASES];  // in the order of their first end
+static int nPhases = 0;
+
+// seconds since an arbitrary point in time, never decreasing
+static double getMonotonicTime() {
 #if WINDOWS
-    sprintf(cmd, "rmdir /S /Q %s", fmuTempPath);
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart / (double)frequency.QuadPart;
 #else /* WINDOWS */
-    sprintf(cmd, "rm -rf %s", fmuTempPath);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
 #endif /* WINDOWS */
-    system(cmd);
-    free(cmd);
-    free(fmuTempPath);
 }
 
-static void doubleToCommaString(char* buffer, double r){
-    char* comma;
-    sprintf(buffer, "%.16g", r);
-    comma = strchr(buffer, '.');
-    if (comma) *comma = ',';
+int startTiming(const char *mode) {
+    if (!mode || !strcmp(mode, "off")) {
+        timingMode = 0;
+    } else if (!strcmp(mode, "text")) {
+        timingMode = 1;
+    } else if (!strcmp(mode, "json")) {
+        timingMode = 2;
+    } else {
+        printf("error: Unknown value of option --timing: %s\n", mode);
+        return 0;
+    }
+    timingStart = phaseStart = getMonotonicTime();
+    nPhases = 0;
+    return 1;
+}
+
+void endPhase(const char *name) {
+    double now;
+    int i;
+    if (!timingMode) return;
+    now = getMonotonicTime();
+    for (i = 0; i < nPhases && strcmp(phases[i].name, name); i++);
+    if (i == nPhases && nPhases < MAX_PHASES) {
+        phases[i].name = name;
+        phases[i].seconds = 0;
+        nPhases++;
+    }
+    if (i < nPhases) phases[i].seconds += now - phaseStart;
+    phaseStart = now;
+}
+
+// write s as JSON string, with quotes
+static void writeJsonString(FILE *file, const char *s) {
+    fputc('"', file);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(file, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(file, "\\u%04x", (unsigned char)*s);
+        } else {
+            fputc(*s, file);
+        }
+    }
+    fputc('"', file);
+}
+
+int reportTiming(const char *fmuFileName) {
+    double total;
+    FILE *file;
+    int i;
+    if (!timingMode) return 1;
+    total = getMonotonicTime() - timingStart;
+    if (timingMode == 1) {
+        printf("Timing of the phases in ms\n");
+        // the names are padded with dots like the simulation summary
+        for (i = 0; i < nPhases; i++) {
+            printf("  %s %.*s %.3f\n", phases[i].name, (int)(17 - strlen(phases[i].name)),
+                   TIMING_DOTS, 1e3 * phases[i].seconds);
+        }
+        printf("  total %s %.3f\n", TIMING_DOTS + 5, 1e3 * total);
+        return 1;
+    }
+    file = fopen(TIMING_FILE, "w");
+    if (!file) {
+        printf("error: Could not write %s: %s\n", TIMING_FILE, strerror(errno));
+        return 0;
+    }
+    fprintf(file, "{\n  \"fmu\": ");
+    writeJsonString(file, fmuFileName);
+    fprintf(file, ",\n  \"phases\": {\n");
+    for (i = 0; i < nPhases; i++) {
+        fprintf(file, "    ");
+        writeJsonString(file, phases[i].name);
+        fprintf(file, ": %.9f%s\n", phases[i].seconds, i < nPhases - 1 ? "," : "");
+    }
+    fprintf(file, "  },\n  \"total\": %.9f\n}\n", total);
+    fclose(file);
+    printf("Timing file '%s' written\n", TIMING_FILE);
+    return 1;
+}
+
+#define DOUBLE_BUFSIZE 32
+
+// Shortest round-trip formatting of doubles with the Grisu2 algorithm of
+// F. Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers", PLDI 2010. The digits always read back to the same double and
+// are the shortest such digits for nearly all values.
+
+// a floating-point number f * 2^e with a 64 bit significand
+typedef struct {
+    unsigned long long f;
+    int e;
+} DiyFp;
+
+// normalized 10^k for k = -348, -340, ..., 340
+static const unsigned long long cachedPowersF[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+static const short cachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066,
+};
+
+static const unsigned long long pow10Table[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_EXPONENT_MASK    0x7FF0000000000000ULL
+#define DP_HIDDEN_BIT       0x0010000000000000ULL
+#define DP_EXPONENT_BIAS    1075
+
+static DiyFp makeDiyFp(unsigned long long f, int e) {
+    DiyFp x;
+    x.f = f;
+    x.e = e;
+    return x;
+}
+
+// product rounded to 64 bits
+static DiyFp multiplyDiyFp(DiyFp x, DiyFp y) {
+    const unsigned long long m32 = 0xFFFFFFFFULL;
+    unsigned long long a = x.f >> 32, b = x.f & m32;
+    unsigned long long c = y.f >> 32, d = y.f & m32;
+    unsigned long long ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    unsigned long long tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+    tmp += 1ULL << 31; // round
+    return makeDiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+}
+
+static DiyFp normalizeDiyFp(DiyFp x) {
+    while (!(x.f & (1ULL << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+// the normalized boundaries m- and m+ halfway to the neighbors of v
+static void getBoundaries(DiyFp v, DiyFp *minus, DiyFp *plus) {
+    DiyFp p = makeDiyFp((v.f << 1) + 1, v.e - 1);
+    DiyFp m = v.f == DP_HIDDEN_BIT ? makeDiyFp((v.f << 2) - 1, v.e - 2) : makeDiyFp((v.f << 1) - 1, v.e - 1);
+    while (!(p.f & (DP_HIDDEN_BIT << 1))) {
+        p.f <<= 1;
+        p.e--;
+    }
+    p.f <<= 64 - 52 - 2;
+    p.e -= 64 - 52 - 2;
+    m.f <<= m.e - p.e;
+    m.e = p.e;
+    *minus = m;
+    *plus = p;
+}
+
+// cached power c = 10^-K such that the exponent of c * 2^e is in [-60, -32]
+static DiyFp getCachedPower(int e, int *K) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347; // ceil((-61 - e) * log10(2)) + 348 - 1
+    int k = (int)dk;
+    int index;
+    if (dk - k > 0.0) k++;
+    index = (k >> 3) + 1;
+    *K = -(-348 + index * 8);
+    return makeDiyFp(cachedPowersF[index], cachedPowersE[index]);
+}
+
+static void roundDigits(char *buffer, int length, unsigned long long delta, unsigned long long rest,
+                        unsigned long long tenKappa, unsigned long long wpw) {
+    while (rest < wpw && delta - rest >= tenKappa
+           && (rest + tenKappa < wpw || wpw - rest > rest + tenKappa - wpw)) {
+        buffer[length - 1]--;
+        rest += tenKappa;
+    }
+}
+
+static int countDecimalDigits(unsigned int n) {
+    int k = 1;
+    while (k < 10 && n >= pow10Table[k]) k++;
+    return k;
+}
+
+// generate the digits of w within [w - delta, mp]
+static void generateDigits(DiyFp w, DiyFp mp, unsigned long long delta, char *buffer, int *length, int *K) {
+    DiyFp one = makeDiyFp(1ULL << -mp.e, mp.e);
+    unsigned long long wpw = mp.f - w.f;
+    unsigned int p1 = (unsigned int)(mp.f >> -one.e);
+    unsigned long long p2 = mp.f & (one.f - 1);
+    int kappa = countDecimalDigits(p1);
+    *length = 0;
+    while (kappa > 0) {
+        unsigned int divisor = (unsigned int)pow10Table[kappa - 1];
+        unsigned int d = p1 / divisor;
+        unsigned long long rest;
+        p1 %= divisor;
+        if (d || *length) buffer[(*length)++] = (char)('0' + d);
+        kappa--;
+        rest = ((unsigned long long)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *K += kappa;
+            roundDigits(buffer, *length, delta, rest, pow10Table[kappa] << -one.e, wpw);
+            return;
+        }
+    }
+    for (;;) {
+        char d;
+        p2 *= 10;
+        delta *= 10;
+        d = (char)(p2 >> -one.e);
+        if (d || *length) buffer[(*length)++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            roundDigits(buffer, *length, delta, p2, one.f, wpw * pow10Table[-kappa]);
+            return;
+        }
+    }
+}
+
+// digits of the positive, finite value r such that r = digits * 10^K
+static void grisu2(double r, char *buffer, int *length, int *K) {
+    unsigned long long u;
+    int biasedExponent;
+    DiyFp v, w, wm, wp, c;
+    memcpy(&u, &r, sizeof(u));
+    biasedExponent = (int)((u & DP_EXPONENT_MASK) >> 52);
+    if (biasedExponent) {
+        v = makeDiyFp((u & DP_SIGNIFICAND_MASK) + DP_HIDDEN_BIT, biasedExponent - DP_EXPONENT_BIAS);
+    } else {
+        v = makeDiyFp(u & DP_SIGNIFICAND_MASK, 1 - DP_EXPONENT_BIAS);
+    }
+    getBoundaries(v, &wm, &wp);
+    c = getCachedPower(wp.e, K);
+    w = multiplyDiyFp(normalizeDiyFp(v), c);
+    wp = multiplyDiyFp(wp, c);
+    wm = multiplyDiyFp(wm, c);
+    wm.f++;
+    wp.f--;
+    generateDigits(w, wp, wp.f - wm.f, buffer, length, K);
+}
+
+// Write r to buffer in the shortest form that reads back to r, using the
+// given decimal point. Like printf("%.16g") large and small numbers are
+// written with exponent, e.g. 1.5e+16 and 2.5e-05. buffer must have room
+// for DOUBLE_BUFSIZE chars. Return the number of chars written, without
+// terminating 0.
+static int formatDouble(char *buffer, double r, char decimalPoint) {
+    char digits[24];
+    int length, K, exponent, i;
+    char *s = buffer;
+    if (r != r) return sprintf(buffer, "nan");
+    if (r < 0 || (r == 0 && 1 / r < 0)) {
+        *s++ = '-';
+        r = -r;
+    }
+    if (r == 0) {
+        *s++ = '0';
+        *s = '\0';
+        return (int)(s - buffer);
+    }
+    if (r > DBL_MAX) {
+        strcpy(s, "inf");
+        return (int)(s + 3 - buffer);
+    }
+    grisu2(r, digits, &length, &K);
+    while (length > 1 && digits[length - 1] == '0') {
+        length--;
+        K++;
+    }
+    exponent = length + K - 1; // exponent of the first digit
+    if (exponent >= -4 && exponent < 16) {
+        if (K >= 0) {
+            // integer, e.g. 1200
+            memcpy(s, digits, length);
+            s += length;
+            for (i = 0; i < K; i++) *s++ = '0';
+        } else if (exponent >= 0) {
+            // e.g. 12.5
+            memcpy(s, digits, exponent + 1);
+            s += exponent + 1;
+            *s++ = decimalPoint;
+            memcpy(s, digits + exponent + 1, length - exponent - 1);
+            s += length - exponent - 1;
+        } else {
+            // e.g. 0.0125
+            *s++ = '0';
+            *s++ = decimalPoint;
+            for (i = 0; i < -exponent - 1; i++) *s++ = '0';
+            memcpy(s, digits, length);
+            s += length;
+        }
+    } else {
+        *s++ = digits[0];
+        if (length > 1) {
+            *s++ = decimalPoint;
+            memcpy(s, digits + 1, length - 1);
+            s += length - 1;
+        }
+        *s++ = 'e';
+        *s++ = exponent < 0 ? '-' : '+';
+        if (exponent < 0) exponent = -exponent;
+        if (exponent >= 100) *s++ = (char)('0' + exponent / 100);
+        *s++ = (char)('0' + exponent / 10 % 10);
+        *s++ = (char)('0' + exponent % 10);
+    }
+    *s = '\0';
+    return (int)(s - buffer);
+}
+
+// write i to buffer in decimal. Return the number of chars written.
+static int formatInteger(char *buffer, int i) {
+    char digits[12];
+    int n = 0, length = 0;
+    unsigned int u = i < 0 ? 0U - (unsigned int)i : (unsigned int)i;
+    if (i < 0) buffer[length++] = '-';
+    do {
+        digits[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    while (n > 0) buffer[length++] = digits[--n];
+    buffer[length] = '\0';
+    return length;
 }
 
 // output time and all non-alias variables in CSV format
 // if separator is ',', columns are separated by ',' and '.' is used for floating-point numbers.
 // otherwise, the given separator (e.g. ';' or '\t') is to separate columns, and ',' is used
 // as decimal dot in floating-point numbers.
-void outputRow(FMU *fmu, fmiComponent c, double time, FILE* file, char separator, fmiBoolean header) {
+static int writeCsvHeader(OutputWriter *writer) {
     int k;
-    fmiReal r;
-    fmiInteger i;
-    fmiBoolean b;
-    fmiString s;
-    fmiValueReference vr;
-    ScalarVariable** vars = fmu->modelDescription->modelVariables;
-    char buffer[32];
+    FILE *file = writer->file;
+    char separator = writer->separator;
 
     // print first column
-    if (header) 
-        fprintf(file, "time");
-    else {
-        if (separator==',')
-            fprintf(file, "%.16g", time);
-        else {
-            // separator is e.g. ';' or '\t'
-            doubleToCommaString(buffer, time);
-            fprintf(file, "%s", buffer);
-        }
-    }
+    fprintf(file, "time");
 
-    // print all other columns(void *)
-    for (k=0; vars[k]; k++) {
-        ScalarVariable* sv = vars[k];
-        if (getAlias(sv)!=enu_noAlias) continue;
-        if (header) {
-            // output names only
-            if (separator==',') {
-                // treat array element, e.g. print a[1, 2] as a[1.2]
-                const char* s = getName(sv);
-                fprintf(file, "%c", separator);
-                while (*s) {
-                   if (*s!=' ') fprintf(file, "%c", *s==',' ? '.' : *s);
-                   s++;
-                }
-             }
-            else
-                fprintf(file, "%c%s", separator, getName(sv));
-        }
-        else {
-            // output values
-            vr = getValueReference(sv);
-            switch (sv->typeSpec->type){
-                case elm_Real:
-                    fmu->getReal(c, &vr, 1, &r);
-                    if (separator==',') 
-                        fprintf(file, ",%.16g", r);
-                    else {
-                        // separator is e.g. ';' or '\t'
-                        doubleToCommaString(buffer, r);
-                        fprintf(file, "%c%s", separator, buffer);
-                    }
-                    break;
-                case elm_Integer:
-                case elm_Enumeration:
-                    fmu->getInteger(c, &vr, 1, &i);
-                    fprintf(file, "%c%d", separator, i);
-                    break;
-                case elm_Boolean:
-                    fmu->getBoolean(c, &vr, 1, &b);
-                    fprintf(file, "%c%d", separator, b);
-                    break;
-                case elm_String:
-                    fmu->getString(c, &vr, 1, &s);
-                    fprintf(file, "%c%s", separator, s);
-                    break;
-                default: 
-                    fprintf(file, "%cNoValueForType=%d", separator,sv->typeSpec->type);
+    // print all other columns
+    for (k=0; k<writer->n; k++) {
+        ScalarVariable* sv = writer->variables[k];
+        // output names only
+        if (separator==',') {
+            // treat array element, e.g. print a[1, 2] as a[1.2]
+            const char* s = getName(sv);
+            fprintf(file, "%c", separator);
+            while (*s) {
+               if (*s!=' ') fprintf(file, "%c", *s==',' ? '.' : *s);
+               s++;
             }
-        }
+         }
+        else
+            fprintf(file, "%c%s", separator, getName(sv));
     } // for
 
     // terminate this row
     fprintf(file, "\n");
+    return !ferror(file);
+}
+
+static int writeCsvRow(OutputWriter *writer, double time, const OutputValue *values, const char *strings) {
+    int k;
+    char separator = writer->separator;
+    char decimalPoint = separator==',' ? '.' : ',';
+    size_t size = (writer->n + 1) * (DOUBLE_BUFSIZE + 1) + 1;
+    char *s;
+
+    // the row is formatted into writer->text and written at once
+    for (k=0; k<writer->n; k++) {
+        if (writer->types[k]==elm_String) size += strlen(strings + values[k].string);
+    }
+    if (size > writer->textCapacity) {
+        char *text = (char *)realloc(writer->text, size);
+        if (!text) return error("out of memory");
+        writer->text = text;
+        writer->textCapacity = size;
+    }
+    s = writer->text;
+
+    // print first column
+    s += formatDouble(s, time, decimalPoint);
+
+    // print all other columns
+    for (k=0; k<writer->n; k++) {
+        // output values
+        *s++ = separator;
+        switch (writer->types[k]){
+            case elm_Real:
+                s += formatDouble(s, values[k].real, decimalPoint);
+                break;
+            case elm_Integer:
+            case elm_Enumeration:
+                s += formatInteger(s, values[k].integer);
+                break;
+            case elm_Boolean:
+                s += formatInteger(s, values[k].boolean);
+                break;
+            case elm_String:
+                strcpy(s, strings + values[k].string);
+                s += strlen(s);
+                break;
+            default: 
+                s += sprintf(s, "NoValueForType=%d", writer->types[k]);
+        }
+    } // for
+
+    // terminate this row
+    *s++ = '\n';
+    return fwrite(writer->text, 1, s - writer->text, writer->file)==(size_t)(s - writer->text);
+}
+
+static int finishCsv(OutputWriter *writer) {
+    (void)writer;
+    return 1;
+}
+
+// 1 if the platform stores numbers in little-endian byte order
+static int isLittleEndian() {
+    unsigned int one = 1;
+    return *(unsigned char *)&one == 1;
+}
+
+// write n numbers of the given size (at most 8 bytes) in little-endian byte order
+static int writeLittleEndian(const void *data, size_t size, size_t n, FILE *file) {
+    size_t i, j;
+    unsigned char buffer[8];
+    const unsigned char *bytes = (const unsigned char *)data;
+    if (isLittleEndian()) return fwrite(data, size, n, file) == n;
+    for (i=0; i<n; i++) {
+        for (j=0; j<size; j++) buffer[j] = bytes[i * size + size - 1 - j];
+        if (fwrite(buffer, size, 1, file) != 1) return 0;
+    }
+    return 1;
+}
+
+// the binary formats store time and all numeric variables as double
+static int isNumericType(Elm type) {
+    return type==elm_Real || type==elm_Integer || type==elm_Enumeration || type==elm_Boolean;
+}
+
+// collect time and the numeric values of a row in row
+static void getNumericValues(OutputWriter *writer, double time, const OutputValue *values, double *row) {
+    int k, n = 1;
+    row[0] = time;
+    for (k=0; k<writer->n; k++) {
+        switch (writer->types[k]){
+            case elm_Real:
+                row[n++] = values[k].real;
+                break;
+            case elm_Integer:
+            case elm_Enumeration:
+                row[n++] = values[k].integer;
+                break;
+            case elm_Boolean:
+                row[n++] = values[k].boolean;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// collect time and the numeric values of the current row in writer->row
+static void getNumericRow(OutputWriter *writer, double time, const OutputValue *values) {
+    getNumericValues(writer, time, values, writer->row);
+}
+
+// header of a MAT v4 matrix. type is 0 for double, 20 for int32 and 51 for text,
+// with the first digit 0 for little-endian byte order
+static int writeMatrixHeader(FILE *file, int type, int mrows, int ncols, const char *name) {
+    int header[5];
+    header[0] = type;
+    header[1] = mrows;
+    header[2] = ncols;
+    header[3] = 0; // no imaginary part
+    header[4] = (int)strlen(name) + 1;
+    return writeLittleEndian(header, sizeof(int), 5, file)
+        && fwrite(name, 1, strlen(name) + 1, file) == strlen(name) + 1;
+}
+
+// text matrix with one string per column, padded with blanks
+static int writeMatStrings(FILE *file, const char *name, int n, const char **strings) {
+    int i, k;
+    int length = 1;
+    for (i=0; i<n; i++) {
+        if ((int)strlen(strings[i]) > length) length = (int)strlen(strings[i]);
+    }
+    if (!writeMatrixHeader(file, 51, length, n, name)) return 0;
+    for (i=0; i<n; i++) {
+        int m = (int)strlen(strings[i]);
+        fwrite(strings[i], 1, m, file);
+        for (k=m; k<length; k++) fputc(' ', file);
+    }
+    return !ferror(file);
+}
+
+// Write the header of a MAT v4 file in the layout of Dymola and OpenModelica
+// results: the names and descriptions of the variables, dataInfo that maps
+// them to the columns of data_2 and the start and end time in data_1.
+// data_2 holds one column per row of the result, its size and the end time
+// are set by finishMat(). String variables are not written.
+static int writeMatHeader(OutputWriter *writer) {
+    int i, k, n;
+    // Aclass is a 4 x 11 text matrix stored column by column
+    const char *aclass[4] = { "Atrajectory", "1.1        ", "           ", "binTrans   " };
+    char aclassData[44];
+    const char **names = (const char **)calloc(writer->nColumns, sizeof(char *));
+    const char **descriptions = (const char **)calloc(writer->nColumns, sizeof(char *));
+    int *dataInfo = (int *)calloc(4 * writer->nColumns, sizeof(int));
+    double data1[2] = { 0, 0 };
+    FILE *file = writer->file;
+    ModelDescription* md = writer->fmu->modelDescription;
+    int ok = names && descriptions && dataInfo;
+
+    if (ok) {
+        for (i=0; i<4; i++) {
+            for (k=0; k<11; k++) aclassData[k * 4 + i] = aclass[i][k];
+        }
+        names[0] = "time";
+        descriptions[0] = "Time in [s]";
+        dataInfo[0] = 0; // abscissa
+        dataInfo[1] = 1;
+        dataInfo[2] = 0;
+        dataInfo[3] = -1;
+        for (k=0, n=1; k<writer->n; k++) {
+            ScalarVariable* sv = writer->variables[k];
+            if (!isNumericType(writer->types[k])) continue;
+            names[n] = getName(sv);
+            descriptions[n] = getDescription(md, sv);
+            if (!descriptions[n]) descriptions[n] = "";
+            dataInfo[4 * n] = 2;         // matrix data_2
+            dataInfo[4 * n + 1] = n + 1; // column in data_2
+            dataInfo[4 * n + 2] = 0;     // linear interpolation
+            dataInfo[4 * n + 3] = -1;    // not defined outside of the time range
+            n++;
+        }
+        ok = writeMatrixHeader(file, 51, 4, 11, "Aclass")
+            && fwrite(aclassData, 1, 44, file) == 44
+            && writeMatStrings(file, "name", writer->nColumns, names)
+            && writeMatStrings(file, "description", writer->nColumns, descriptions)
+            && writeMatrixHeader(file, 20, 4, writer->nColumns, "dataInfo")
+            && writeLittleEndian(dataInfo, sizeof(int), 4 * writer->nColumns, file);
+    }
+    if (ok) {
+        writer->data1Pos = ftell(file);
+        ok = writeMatrixHeader(file, 0, 1, 2, "data_1") && writeLittleEndian(data1, sizeof(double), 2, file);
+    }
+    if (ok) {
+        writer->data2Pos = ftell(file);
+        ok = writeMatrixHeader(file, 0, writer->nColumns, 0, "data_2");
+    }
+    free((void *)names);
+    free((void *)descriptions);
+    free(dataInfo);
+    return ok;
+}
+
+static int writeMatRow(OutputWriter *writer, double time, const OutputValue *values, const char *strings) {
+    (void)strings;
+    getNumericRow(writer, time, values);
+    if (writer->nRows == 0) writer->tStart = time;
+    writer->tEnd = time;
+    return writeLittleEndian(writer->row, sizeof(double), writer->nColumns, writer->file);
+}
+
+// set the end time in data_1 and the number of columns of data_2
+static int finishMat(OutputWriter *writer) {
+    int ncols = (int)writer->nRows;
+    double data1[2];
+    data1[0] = writer->tStart;
+    data1[1] = writer->tEnd;
+    return fseek(writer->file, writer->data1Pos + 20 + 7, SEEK_SET) == 0
+        && writeLittleEndian(data1, sizeof(double), 2, writer->file)
+        && fseek(writer->file, writer->data2Pos + 8, SEEK_SET) == 0
+        && writeLittleEndian(&ncols, sizeof(int), 1, writer->file)
+        && fseek(writer->file, 0, SEEK_END) == 0;
+}
+
+// The raw format is column oriented. The rows are streamed to a temporary file
+// while simulating and transposed into the result file when the simulation has
+// finished. All numbers are little-endian:
+//   char[8]  "FMURAW1\0"
+//   uint32   number of columns n, including time
+//   uint32   number of rows m
+//   n times: uint32 length of the name, name in UTF-8 without terminating 0
+//   n times: m values of the column as double
+// String variables are not written.
+// The names are copied here, the model description may be gone when the file is completed.
+static int writeRawHeader(OutputWriter *writer) {
+    int k;
+    size_t size = strlen("time") + 1;
+    char *name;
+    for (k=0; k<writer->n; k++) {
+        if (isNumericType(writer->types[k])) size += strlen(getName(writer->variables[k])) + 1;
+    }
+    writer->names = (char *)calloc(size, sizeof(char));
+    if (!writer->names) return error("out of memory");
+    strcpy(writer->names, "time");
+    name = writer->names + strlen("time") + 1;
+    for (k=0; k<writer->n; k++) {
+        if (!isNumericType(writer->types[k])) continue;
+        strcpy(name, getName(writer->variables[k]));
+        name += strlen(name) + 1;
+    }
+    writer->rows = tmpfile();
+    if (!writer->rows) return error("could not create a temporary file");
+    return 1;
+}
+
+static int writeRawRow(OutputWriter *writer, double time, const OutputValue *values, const char *strings) {
+    (void)strings;
+    getNumericRow(writer, time, values);
+    return fwrite(writer->row, sizeof(double), writer->nColumns, writer->rows) == (size_t)writer->nColumns;
+}
+
+// number of rows transposed at once by finishRaw()
+#define RAW_CHUNK_ROWS 4096
+
+// write the header and transpose the rows chunk by chunk: each column of a chunk
+// is gathered into a contiguous buffer and written at its place in the column
+static int finishRaw(OutputWriter *writer) {
+    int n;
+    long i, row, nRows;
+    long dataPos = 0;
+    unsigned int header[2];
+    const char *name = writer->names;
+    FILE *file = writer->file;
+    double *chunk = NULL;
+    double *column = NULL;
+    int ok = writer->rows && fwrite("FMURAW1", 1, 8, file) == 8;
+
+    header[0] = (unsigned int)writer->nColumns;
+    header[1] = (unsigned int)writer->nRows;
+    ok = ok && writeLittleEndian(header, sizeof(unsigned int), 2, file);
+    for (n=0; ok && n<writer->nColumns; n++) {
+        unsigned int length = (unsigned int)strlen(name);
+        ok = writeLittleEndian(&length, sizeof(unsigned int), 1, file) && fwrite(name, 1, length, file) == length;
+        name += length + 1;
+    }
+    if (ok) {
+        dataPos = ftell(file);
+        chunk = (double *)malloc(RAW_CHUNK_ROWS * writer->nColumns * sizeof(double));
+        column = (double *)malloc(RAW_CHUNK_ROWS * sizeof(double));
+        if (!chunk || !column) ok = error("out of memory");
+        ok = ok && fseek(writer->rows, 0, SEEK_SET) == 0;
+    }
+    for (row = 0; ok && row < writer->nRows; row += nRows) {
+        nRows = writer->nRows - row < RAW_CHUNK_ROWS ? writer->nRows - row : RAW_CHUNK_ROWS;
+        ok = fread(chunk, writer->nColumns * sizeof(double), nRows, writer->rows) == (size_t)nRows;
+        for (n=0; ok && n<writer->nColumns; n++) {
+            for (i=0; i<nRows; i++) column[i] = chunk[i * writer->nColumns + n];
+            ok = fseek(file, dataPos + (long)((n * writer->nRows + row) * sizeof(double)), SEEK_SET) == 0
+                && writeLittleEndian(column, sizeof(double), nRows, file);
+        }
+    }
+    free(chunk);
+    free(column);
+    return ok && fseek(file, 0, SEEK_END) == 0;
+}
+
+static const char *formatNames[] = { "csv", "mat", "raw" };
+static const char *resultFiles[] = { RESULT_FILE, RESULT_FILE_MAT, RESULT_FILE_RAW };
+
+int getOutputFormat(const char *name, OutputFormat *format) {
+    int i;
+    for (i=0; i<(int)(sizeof(formatNames) / sizeof(formatNames[0])); i++) {
+        if (!strcmp(name, formatNames[i])) {
+            *format = (OutputFormat)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *getResultFileName(OutputFormat format) {
+    return resultFiles[format];
+}
+
+static void freeOutputBlock(OutputBlock *block) {
+    free(block->times);
+    free(block->values);
+    free(block->strings);
+}
+
+static void freeOutputBlocks(OutputWriter *writer) {
+    int i;
+    for (i=0; i<OUTPUT_BLOCKS; i++) freeOutputBlock(&writer->blocks[i]);
+    freeOutputBlock(&writer->lttbRows[0]);
+    freeOutputBlock(&writer->lttbRows[1]);
+    free(writer->lttbAnchor);
+    free(writer->lttbMean);
+    free(writer->lttbPoint);
+}
+
+// make room for capacity rows in the block. Return 0 if out of memory.
+static int reserveOutputBlock(OutputWriter *writer, OutputBlock *block, int capacity) {
+    // allocate at least one value per row, calloc(0, ...) may return NULL
+    int n = writer->n > 0 ? writer->n : 1;
+    double *times = (double *)realloc(block->times, capacity * sizeof(double));
+    OutputValue *values;
+    if (!times) return 0;
+    block->times = times;
+    values = (OutputValue *)realloc(block->values, capacity * n * sizeof(OutputValue));
+    if (!values) return 0;
+    block->values = values;
+    block->capacity = capacity;
+    return 1;
+}
+
+static int allocateOutputBlocks(OutputWriter *writer) {
+    int i;
+    for (i=0; i<OUTPUT_BLOCKS; i++) {
+        if (!reserveOutputBlock(writer, &writer->blocks[i], OUTPUT_BLOCK_ROWS)) return 0;
+    }
+    if (writer->points > 0) {
+        writer->lttbAnchor = (double *)calloc(writer->nColumns, sizeof(double));
+        writer->lttbMean = (double *)calloc(writer->nColumns, sizeof(double));
+        writer->lttbPoint = (double *)calloc(writer->nColumns, sizeof(double));
+        if (!writer->lttbAnchor || !writer->lttbMean || !writer->lttbPoint) return 0;
+    }
+    return 1;
+}
+
+// write the rows of a block in the format of the writer. Return 0 on errors.
+static int writeOutputBlock(OutputWriter *writer, OutputBlock *block) {
+    int i;
+    for (i=0; i<block->nRows; i++) {
+        const OutputValue *values = block->values + i * writer->n;
+        if (!writer->writeRow(writer, block->times[i], values, block->strings)) return 0;
+        writer->nRows++;
+    }
+    return 1;
+}
+
+#if WINDOWS
+static void lockWriter(OutputWriter *writer)   { EnterCriticalSection(&writer->lock); }
+static void unlockWriter(OutputWriter *writer) { LeaveCriticalSection(&writer->lock); }
+static void waitWriter(OutputWriter *writer)   { SleepConditionVariableCS(&writer->changed, &writer->lock, INFINITE); }
+static void notifyWriter(OutputWriter *writer) { WakeAllConditionVariable(&writer->changed); }
+#else /* WINDOWS */
+static void lockWriter(OutputWriter *writer)   { pthread_mutex_lock(&writer->lock); }
+static void unlockWriter(OutputWriter *writer) { pthread_mutex_unlock(&writer->lock); }
+static void waitWriter(OutputWriter *writer)   { pthread_cond_wait(&writer->changed, &writer->lock); }
+static void notifyWriter(OutputWriter *writer) { pthread_cond_broadcast(&writer->changed); }
+#endif /* WINDOWS */
+
+// Writer thread: write the queued blocks in order until the writer is closed.
+// After an error, the remaining blocks are dropped to keep the simulation going.
+static void runWriter(OutputWriter *writer) {
+    lockWriter(writer);
+    for (;;) {
+        OutputBlock *block;
+        int failed;
+        while (writer->nQueued == 0 && !writer->closing) waitWriter(writer);
+        if (writer->nQueued == 0) break;
+        block = &writer->blocks[writer->head];
+        failed = writer->failed;
+        unlockWriter(writer);
+        if (!failed && !writeOutputBlock(writer, block)) failed = 1;
+        lockWriter(writer);
+        if (failed) writer->failed = 1;
+        block->nRows = 0;
+        block->stringsSize = 0;
+        writer->head = (writer->head + 1) % OUTPUT_BLOCKS;
+        writer->nQueued--;
+        notifyWriter(writer);
+    }
+    unlockWriter(writer);
+}
+
+#if WINDOWS
+static DWORD WINAPI writerThread(LPVOID writer) {
+    runWriter((OutputWriter *)writer);
+    return 0;
+}
+
+static int startWriterThread(OutputWriter *writer) {
+    InitializeCriticalSection(&writer->lock);
+    InitializeConditionVariable(&writer->changed);
+    writer->thread = CreateThread(NULL, 0, writerThread, writer, 0, NULL);
+    if (writer->thread) return 1;
+    DeleteCriticalSection(&writer->lock);
+    return 0;
+}
+
+static void joinWriterThread(OutputWriter *writer) {
+    WaitForSingleObject(writer->thread, INFINITE);
+    CloseHandle(writer->thread);
+    DeleteCriticalSection(&writer->lock);
+}
+#else /* WINDOWS */
+static void *writerThread(void *writer) {
+    runWriter((OutputWriter *)writer);
+    return NULL;
+}
+
+static int startWriterThread(OutputWriter *writer) {
+    if (pthread_mutex_init(&writer->lock, NULL) != 0) return 0;
+    if (pthread_cond_init(&writer->changed, NULL) != 0) {
+        pthread_mutex_destroy(&writer->lock);
+        return 0;
+    }
+    if (pthread_create(&writer->thread, NULL, writerThread, writer) == 0) return 1;
+    pthread_cond_destroy(&writer->changed);
+    pthread_mutex_destroy(&writer->lock);
+    return 0;
+}
+
+static void joinWriterThread(OutputWriter *writer) {
+    pthread_join(writer->thread, NULL);
+    pthread_cond_destroy(&writer->changed);
+    pthread_mutex_destroy(&writer->lock);
+}
+#endif /* WINDOWS */
+
+// the writer that is not closed yet, if any
+static OutputWriter *openWriter = NULL;
+
+// the simulators may return early on errors without closing the writer,
+// write the rows collected so far when the program exits
+static void closeOpenWriter(void) {
+    if (openWriter) closeOutputWriter(openWriter);
+}
+
+// block filled by outputRow()
+static OutputBlock *getFillBlock(OutputWriter *writer) {
+    return &writer->blocks[(writer->head + writer->nQueued) % OUTPUT_BLOCKS];
+}
+
+// hand the filled block to the writer thread and wait until the next block is free.
+// Without a thread, the block is written in place. Return 0 if writing failed.
+static int queueFillBlock(OutputWriter *writer) {
+    int failed;
+    if (!writer->threaded) {
+        OutputBlock *block = getFillBlock(writer);
+        if (!writer->failed && !writeOutputBlock(writer, block)) writer->failed = 1;
+        block->nRows = 0;
+        block->stringsSize = 0;
+        return !writer->failed;
+    }
+    lockWriter(writer);
+    writer->nQueued++;
+    notifyWriter(writer);
+    while (writer->nQueued == OUTPUT_BLOCKS) waitWriter(writer);
+    failed = writer->failed;
+    unlockWriter(writer);
+    return !failed;
+}
+
+// copy a string value into the strings of the block. Return 0 if out of memory.
+static int copyOutputString(OutputBlock *block, const char *s, size_t *position) {
+    size_t n = strlen(s ? s : "") + 1;
+    if (block->stringsSize + n > block->stringsCapacity) {
+        size_t capacity = 2 * block->stringsCapacity;
+        char *strings;
+        if (capacity < block->stringsSize + n) capacity = block->stringsSize + n;
+        strings = (char *)realloc(block->strings, capacity);
+        if (!strings) return 0;
+        block->strings = strings;
+        block->stringsCapacity = capacity;
+    }
+    memcpy(block->strings + block->stringsSize, s ? s : "", n);
+    *position = block->stringsSize;
+    block->stringsSize += n;
+    return 1;
+}
+
+// match name against a pattern with the wildcards * (any chars) and ? (one char)
+static int matchPattern(const char *pattern, const char *name) {
+    const char *star = NULL;
+    const char *resume = NULL;
+    while (*name) {
+        if (*pattern=='*') {
+            star = pattern++;
+            resume = name;
+        }
+        else if (*pattern=='?' || *pattern==*name) {
+            pattern++;
+            name++;
+        }
+        else if (star) {
+            pattern = star + 1;
+            name = ++resume;
+        }
+        else return 0;
+    }
+    while (*pattern=='*') pattern++;
+    return *pattern=='\0';
+}
+
+// 1 if the filter selects the variable for the result file
+static int isOutputVariable(const OutputFilter *filter, ScalarVariable *sv) {
+    int i;
+    if (!filter) return 1;
+    if (filter->nCausalities > 0) {
+        Enu causality = getCausality(sv);
+        for (i=0; i<filter->nCausalities; i++) {
+            if (causality==filter->causalities[i]) break;
+        }
+        if (i==filter->nCausalities) return 0;
+    }
+    if (filter->nPatterns==0) return 1;
+    for (i=0; i<filter->nPatterns; i++) {
+        if (matchPattern(filter->patterns[i], getName(sv))) return 1;
+    }
+    return 0;
+}
+
+// fetch time and the values of the selected variables from the FMU and append them
+// to the block. Return 0 if out of memory.
+static int appendRow(FMU *fmu, fmiComponent c, OutputWriter *writer, OutputBlock *block, double time) {
+    int k;
+    fmiString s;
+    fmiValueReference vr;
+    OutputValue *values;
+    if (block->nRows==block->capacity && !reserveOutputBlock(writer, block, 2 * block->capacity + 1)) return 0;
+    values = block->values + block->nRows * writer->n;
+    for (k=0; k<writer->n; k++) {
+        ScalarVariable* sv = writer->variables[k];
+        vr = getValueReference(sv);
+        switch (sv->typeSpec->type){
+            case elm_Real:
+                fmu->getReal(c, &vr, 1, &values[k].real);
+                break;
+            case elm_Integer:
+            case elm_Enumeration:
+                fmu->getInteger(c, &vr, 1, &values[k].integer);
+                break;
+            case elm_Boolean:
+                fmu->getBoolean(c, &vr, 1, &values[k].boolean);
+                break;
+            case elm_String:
+                fmu->getString(c, &vr, 1, &s);
+                if (!copyOutputString(block, s, &values[k].string)) return 0;
+                break;
+            default:
+                break;
+        }
+    }
+    block->times[block->nRows++] = time;
+    return 1;
+}
+
+// append row i of block from to the current block of the ring and queue the
+// block when it is full. Return 0 on errors.
+static int writeBlockRow(OutputWriter *writer, OutputBlock *from, int i) {
+    int k;
+    OutputBlock *block = getFillBlock(writer);
+    const OutputValue *source = from->values + i * writer->n;
+    OutputValue *values = block->values + block->nRows * writer->n;
+    for (k=0; k<writer->n; k++) {
+        values[k] = source[k];
+        if (writer->types[k]==elm_String
+            && !copyOutputString(block, from->strings + source[k].string, &values[k].string)) {
+            return error("out of memory");
+        }
+    }
+    block->times[block->nRows++] = from->times[i];
+    if (block->nRows==OUTPUT_BLOCK_ROWS && !queueFillBlock(writer)) {
+        return error("could not write result row");
+    }
+    return 1;
+}
+
+// time and numeric values of row i of the block
+static void getNumericBlockRow(OutputWriter *writer, OutputBlock *block, int i, double *row) {
+    getNumericValues(writer, block->times[i], block->values + i * writer->n, row);
+}
+
+// Largest-triangle-three-buckets: write the row of the block that forms the largest
+// triangle with the row written last and the point next, which is the mean of the
+// following bucket or the last row. The areas of all numeric columns are summed up.
+static int writeLargestTriangle(OutputWriter *writer, OutputBlock *block, const double *next) {
+    int i, k;
+    int best = 0;
+    double bestArea = -1;
+    const double *a = writer->lttbAnchor;
+    double *p = writer->lttbPoint;
+    if (block->nRows==0) return 1;
+    for (i=0; i<block->nRows; i++) {
+        double area = 0;
+        getNumericBlockRow(writer, block, i, p);
+        for (k=1; k<writer->nColumns; k++) {
+            area += fabs((a[0] - next[0]) * (p[k] - a[k]) - (a[0] - p[0]) * (next[k] - a[k]));
+        }
+        if (area > bestArea) {
+            best = i;
+            bestArea = area;
+        }
+    }
+    getNumericBlockRow(writer, block, best, writer->lttbAnchor);
+    return writeBlockRow(writer, block, best);
+}
+
+// compute in lttbMean the mean time and numeric values of the rows of the block
+static void getMeanRow(OutputWriter *writer, OutputBlock *block) {
+    int i, k;
+    for (k=0; k<writer->nColumns; k++) writer->lttbMean[k] = 0;
+    for (i=0; i<block->nRows; i++) {
+        getNumericBlockRow(writer, block, i, writer->lttbPoint);
+        for (k=0; k<writer->nColumns; k++) writer->lttbMean[k] += writer->lttbPoint[k];
+    }
+    for (k=0; k<writer->nColumns; k++) writer->lttbMean[k] /= block->nRows;
+}
+
+// Downsample streaming with LTTB: the time range is divided into points - 2 buckets.
+// Rows are collected for two buckets: the bucket to select from and the next one.
+// When a row arrives beyond the next bucket, one row is selected and written.
+static int downsampleRow(FMU *fmu, fmiComponent c, OutputWriter *writer, double time) {
+    OutputBlock *rows = writer->lttbRows;
+    int bucket;
+    if (!writer->lttbStarted) {
+        // the first row is always written
+        OutputBlock *block = getFillBlock(writer);
+        if (!appendRow(fmu, c, writer, block, time)) return error("out of memory");
+        getNumericBlockRow(writer, block, block->nRows - 1, writer->lttbAnchor);
+        writer->lttbStarted = 1;
+        return 1;
+    }
+    bucket = (int)floor((time - writer->lttbStart) / writer->lttbWidth);
+    if (bucket < 0) bucket = 0;
+    if (bucket > writer->points - 3) bucket = writer->points - 3;
+    if (rows[0].nRows > 0 && bucket!=writer->lttbBuckets[0]) {
+        if (rows[1].nRows > 0 && bucket!=writer->lttbBuckets[1]) {
+            OutputBlock selected = rows[0];
+            getMeanRow(writer, &rows[1]);
+            if (!writeLargestTriangle(writer, &rows[0], writer->lttbMean)) return 0;
+            // the next bucket becomes the bucket to select from
+            rows[0] = rows[1];
+            writer->lttbBuckets[0] = writer->lttbBuckets[1];
+            rows[1] = selected;
+            rows[1].nRows = 0;
+            rows[1].stringsSize = 0;
+        }
+        if (!appendRow(fmu, c, writer, &rows[1], time)) return error("out of memory");
+        writer->lttbBuckets[1] = bucket;
+        return 1;
+    }
+    if (!appendRow(fmu, c, writer, &rows[0], time)) return error("out of memory");
+    writer->lttbBuckets[0] = bucket;
+    return 1;
+}
+
+// write the rows selected from the remaining buckets and the last row
+static int finishDownsampling(OutputWriter *writer) {
+    OutputBlock *rows = writer->lttbRows;
+    OutputBlock *last = rows[1].nRows > 0 ? &rows[1] : &rows[0];
+    if (last->nRows==0) return 1;
+    // hide the last row from the selection, its values stay in the block
+    last->nRows--;
+    if (rows[0].nRows > 0) {
+        if (rows[1].nRows > 0) getMeanRow(writer, &rows[1]);
+        else getNumericBlockRow(writer, last, last->nRows, writer->lttbMean);
+        if (!writeLargestTriangle(writer, &rows[0], writer->lttbMean)) return 0;
+    }
+    if (rows[1].nRows > 0) {
+        getNumericBlockRow(writer, last, last->nRows, writer->lttbMean);
+        if (!writeLargestTriangle(writer, &rows[1], writer->lttbMean)) return 0;
+    }
+    return writeBlockRow(writer, last, last->nRows);
+}
+
+OutputWriter *createOutputWriter(FMU *fmu, OutputFormat format, char separator, const OutputFilter *filter) {
+    int k;
+    const char *fileName = getResultFileName(format);
+    ScalarVariable** vars = fmu->modelDescription->modelVariables;
+    OutputWriter *writer = (OutputWriter *)calloc(1, sizeof(OutputWriter));
+    if (!writer) {
+        error("out of memory");
+        return NULL;
+    }
+    writer->format = format;
+    writer->fmu = fmu;
+    writer->separator = separator;
+    writer->every = filter ? filter->every : 1;
+    if (filter && filter->points > 0) {
+        writer->points = filter->points;
+        writer->lttbStart = filter->tStart;
+        writer->lttbWidth = (filter->tEnd - filter->tStart) / (filter->points - 2);
+    }
+
+    // one column per selected non-alias variable, in the order of the model description
+    for (k=0; vars[k]; k++);
+    writer->variables = (ScalarVariable **)calloc(k + 1, sizeof(ScalarVariable *));
+    writer->types = (Elm *)calloc(k + 1, sizeof(Elm));
+    if (!writer->variables || !writer->types) {
+        free(writer->variables);
+        free(writer->types);
+        free(writer);
+        error("out of memory");
+        return NULL;
+    }
+    writer->nColumns = 1;
+    for (k=0; vars[k]; k++) {
+        if (getAlias(vars[k])!=enu_noAlias || !isOutputVariable(filter, vars[k])) continue;
+        writer->variables[writer->n] = vars[k];
+        writer->types[writer->n++] = vars[k]->typeSpec->type;
+        if (isNumericType(vars[k]->typeSpec->type)) writer->nColumns++;
+    }
+    writer->row = (double *)calloc(writer->nColumns, sizeof(double));
+    if (!writer->row || !allocateOutputBlocks(writer)) {
+        freeOutputBlocks(writer);
+        free(writer->variables);
+        free(writer->types);
+        free(writer->row);
+        free(writer);
+        error("out of memory");
+        return NULL;
+    }
+    switch (format) {
+        case format_mat:
+            writer->writeHeader = writeMatHeader;
+            writer->writeRow = writeMatRow;
+            writer->finish = finishMat;
+            break;
+        case format_raw:
+            writer->writeHeader = writeRawHeader;
+            writer->writeRow = writeRawRow;
+            writer->finish = finishRaw;
+            break;
+        default:
+            writer->writeHeader = writeCsvHeader;
+            writer->writeRow = writeCsvRow;
+            writer->finish = finishCsv;
+    }
+
+    // open result file
+    if (!(writer->file = fopen(fileName, format==format_csv ? "w" : "wb"))) {
+        printf("could not write %s because:\n", fileName);
+        printf("    %s\n", strerror(errno));
+        freeOutputBlocks(writer);
+        free(writer->variables);
+        free(writer->types);
+        free(writer->row);
+        free(writer);
+        return NULL;
+    }
+    if (!writer->writeHeader(writer)) {
+        printf("could not write %s\n", fileName);
+        closeOutputWriter(writer);
+        return NULL;
+    }
+    // without a thread the writer still works, but blocks the simulation while writing
+    writer->threaded = startWriterThread(writer);
+    if (!openWriter) atexit(closeOpenWriter);
+    openWriter = writer;
+    return writer;
+}
+
+int closeOutputWriter(OutputWriter *writer) {
+    int ok;
+    if (!writer) return 0;
+    if (writer==openWriter) openWriter = NULL;
+    if (writer->points > 0 && !finishDownsampling(writer)) writer->failed = 1;
+    if (getFillBlock(writer)->nRows > 0) queueFillBlock(writer);
+    if (writer->threaded) {
+        lockWriter(writer);
+        writer->closing = 1;
+        notifyWriter(writer);
+        unlockWriter(writer);
+        joinWriterThread(writer);
+    }
+    ok = !writer->failed && writer->finish(writer);
+    if (fclose(writer->file) != 0) ok = 0;
+    if (!ok) printf("could not write %s\n", getResultFileName(writer->format));
+    freeOutputBlocks(writer);
+    free(writer->variables);
+    free(writer->types);
+    free(writer->row);
+    if (writer->rows) fclose(writer->rows);
+    free(writer->names);
+    free(writer->text);
+    free(writer);
+    return ok;
+}
+
+// copy time and the selected variables into the current block.
+// Rows dropped by decimation are not fetched from the FMU.
+int outputRow(FMU *fmu, fmiComponent c, OutputWriter *writer, double time) {
+    OutputBlock *block;
+    if (writer->nSamples++ % writer->every != 0) return 1;
+    if (writer->points > 0) return downsampleRow(fmu, c, writer, time);
+    block = getFillBlock(writer);
+    if (!appendRow(fmu, c, writer, block, time)) return error("out of memory");
+    if (block->nRows==OUTPUT_BLOCK_ROWS && !queueFillBlock(writer)) {
+        return error("could not write result row");
+    }
+    return 1;
 }
 
 static const char* fmiStatusToString(fmiStatus status){
@@ -547,7 +2040,77 @@ int error(const char* message){
     return 0;
 }
 
-void parseArguments(int argc, char *argv[], const char** fmuFileName, double* tEnd, double* h, int* loggingOn, char* csv_separator) {
+// arg of length n up to '=' is the option with the given name
+static int isOption(const char *arg, size_t n, const char *name) {
+    return n==strlen(name) && !strncmp(arg, name, n);
+}
+
+// parse an option of the form --name=value. Return 0 if the option is not known.
+static int parseOption(const char *arg, SimOptions *options) {
+    const char *value = strchr(arg, '=');
+    size_t n = value ? (size_t)(value - arg) : strlen(arg);
+    if (!value) return 0;
+    value++;
+    if (isOption(arg, n, "--cache")) {
+        options->cache = value;
+        return 1;
+    }
+    if (isOption(arg, n, "--load")) {
+        options->load = value;
+        return 1;
+    }
+    if (isOption(arg, n, "--output-format")) {
+        options->outputFormat = value;
+        return 1;
+    }
+    if (isOption(arg, n, "--output-variables")) {
+        options->outputVariables = value;
+        return 1;
+    }
+    if (isOption(arg, n, "--output-causality")) {
+        options->outputCausality = value;
+        return 1;
+    }
+    if (isOption(arg, n, "--output-every")) {
+        options->outputEvery = value;
+        return 1;
+    }
+    if (isOption(arg, n, "--output-points")) {
+        options->outputPoints = value;
+        return 1;
+    }
+    if (isOption(arg, n, "--timing")) {
+        options->timing = value;
+        return 1;
+    }
+    return 0;
+}
+
+void parseArguments(int argc, char *argv[], const char** fmuFileName, double* tEnd, double* h, int* loggingOn, char* csv_separator,
+                    SimOptions* options) {
+    int i;
+    int n = 1;
+    char **args = (char **)calloc(sizeof(char *), argc + 1);
+
+    // options may be given anywhere, the remaining arguments are positional
+    if (!args) {
+        printf("error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    args[0] = argv[0];
+    for (i=1; i<argc; i++) {
+        if (strncmp(argv[i], "--", 2)==0) {
+            if (!parseOption(argv[i], options)) {
+                printf("error: The given option (%s) is not valid\n", argv[i]);
+                printHelp(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else args[n++] = argv[i];
+    }
+    argc = n;
+    argv = args;
+
     // parse command line arguments
     if (argc>1) {
         *fmuFileName = argv[1];
@@ -590,13 +2153,131 @@ void parseArguments(int argc, char *argv[], const char** fmuFileName, double* tE
         printf("warning: Ignoring %d additional arguments: %s ...\n", argc-6, argv[6]);
         printHelp(argv[0]);
     }
+    free(args);
+}
+
+static const Enu causalities[] = { enu_input, enu_output, enu_internal, enu_none };
+
+// split a comma separated list in place into its n items, items must be of size n
+static void splitList(char *list, char **items, int n) {
+    int i;
+    for (i=0; i<n; i++) {
+        char *end = strchr(list, ',');
+        items[i] = list;
+        if (end) *end = '\0';
+        list = end + 1;
+    }
+}
+
+static int countListItems(const char *list) {
+    int n = 1;
+    for (; *list; list++) if (*list==',') n++;
+    return n;
+}
+
+int createOutputFilter(const SimOptions *options, double tStart, double tEnd, OutputFilter *filter) {
+    int i, k, n;
+    char **names;
+
+    memset(filter, 0, sizeof(OutputFilter));
+    filter->every = 1;
+    filter->tStart = tStart;
+    filter->tEnd = tEnd;
+    if (options->outputEvery) {
+        if (sscanf(options->outputEvery, "%d", &filter->every) != 1 || filter->every<1) {
+            printf("error: The given output decimation (%s) is not a positive integer\n", options->outputEvery);
+            return 0;
+        }
+    }
+    if (options->outputPoints) {
+        if (sscanf(options->outputPoints, "%d", &filter->points) != 1 || filter->points<3) {
+            printf("error: The given number of output points (%s) is not an integer >= 3\n", options->outputPoints);
+            return 0;
+        }
+        if (tEnd<=tStart) filter->points = 0;
+    }
+    if (!options->outputVariables && !options->outputCausality) return 1;
+
+    // one buffer holds both lists, split in place
+    n = (options->outputVariables ? strlen(options->outputVariables) + 1 : 0)
+        + (options->outputCausality ? strlen(options->outputCausality) + 1 : 0);
+    filter->buffer = (char *)calloc(n, sizeof(char));
+    if (!filter->buffer) return error("out of memory");
+    if (options->outputVariables) {
+        filter->nPatterns = countListItems(options->outputVariables);
+        filter->patterns = (char **)calloc(filter->nPatterns, sizeof(char *));
+        if (!filter->patterns) {
+            freeOutputFilter(filter);
+            return error("out of memory");
+        }
+        strcpy(filter->buffer, options->outputVariables);
+        splitList(filter->buffer, filter->patterns, filter->nPatterns);
+    }
+    if (options->outputCausality) {
+        char *list = filter->buffer + (options->outputVariables ? strlen(options->outputVariables) + 1 : 0);
+        n = countListItems(options->outputCausality);
+        names = (char **)calloc(n, sizeof(char *));
+        filter->causalities = (Enu *)calloc(n, sizeof(Enu));
+        if (!names || !filter->causalities) {
+            free(names);
+            freeOutputFilter(filter);
+            return error("out of memory");
+        }
+        strcpy(list, options->outputCausality);
+        splitList(list, names, n);
+        for (i=0; i<n; i++) {
+            for (k=0; k<(int)(sizeof(causalities) / sizeof(causalities[0])); k++) {
+                if (!strcmp(names[i], enuNames[causalities[k]])) break;
+            }
+            if (k==sizeof(causalities) / sizeof(causalities[0])) {
+                printf("error: The given causality (%s) is not valid\n", names[i]);
+                free(names);
+                freeOutputFilter(filter);
+                return 0;
+            }
+            filter->causalities[filter->nCausalities++] = causalities[k];
+        }
+        free(names);
+    }
+    return 1;
+}
+
+void freeOutputFilter(OutputFilter *filter) {
+    free(filter->patterns);
+    free(filter->causalities);
+    free(filter->buffer);
+    memset(filter, 0, sizeof(OutputFilter));
+    filter->every = 1;
 }
 
 void printHelp(const char* fmusim) {
-    printf("command syntax: %s <model.fmu> <tEnd> <h> <loggingOn> <csv separator>\n", fmusim);
+    printf("command syntax: %s <model.fmu> <tEnd> <h> <loggingOn> <csv separator> [options]\n", fmusim);
     printf("   <model.fmu> .... path to FMU, relative to current dir or absolute, required\n");
     printf("   <tEnd> ......... end  time of simulation, optional, defaults to 1.0 sec\n");
     printf("   <h> ............ step size of simulation, optional, defaults to 0.1 sec\n");
     printf("   <loggingOn> .... 1 to activate logging,   optional, defaults to 0\n");
     printf("   <csv separator>. separator in csv file,   optional, c for ',', s for';', defaults to c\n");
+    printf("options, given as --name=value anywhere on the command line:\n");
+    printf("   --cache ........ off (default) unzips the FMU into a temporary directory removed after the\n");
+    printf("                    run, on keeps the unzipped FMUs in %s to be shared by all\n",
+#if WINDOWS
+           "%TEMP%\\" CACHE_DIR_NAME);
+#else /* WINDOWS */
+           "~/.cache/" CACHE_DIR_NAME);
+#endif /* WINDOWS */
+    printf("                    runs, any other value is the directory of the cache. The cache is never\n");
+    printf("                    cleaned up, delete the directory to free its disk space\n");
+    printf("   --load ......... file (default) loads the FMU binary from the unzipped FMU, memory loads it\n");
+    printf("                    from an anonymous memory file (Linux only), only resources are unzipped\n");
+    printf("   --output-format  format of the result file: csv (default) writes %s,\n", RESULT_FILE);
+    printf("                    mat writes a MAT v4 file %s, raw writes %s\n", RESULT_FILE_MAT, RESULT_FILE_RAW);
+    printf("   --output-variables write only the variables matching the given comma separated list of\n");
+    printf("                    names, with wildcards * and ?\n");
+    printf("   --output-causality write only the variables with the given comma separated list of\n");
+    printf("                    causalities: input, output, internal or none\n");
+    printf("   --output-every   write only every n-th row\n");
+    printf("   --output-points  downsample the result to at most n rows, keeping the shape of the\n");
+    printf("                    curves (largest triangle three buckets)\n");
+    printf("   --timing ....... report the time of each phase of the run: text prints them, json writes\n");
+    printf("                    %s\n", TIMING_FILE);
 }
@@ -4,22 +4,22 @@
  * Copyright QTronic GmbH. All rights reserved.
  * -------------------------------------------------------------------------*/
 
-#if WINDOWS
-// Used 7z options, version 4.57:
-// -x   Extracts files from an archive with their full paths in the current dir, or in an output dir if specified
-// -aoa Overwrite All existing files without prompt
-// -o   Specifies a destination directory where files are to be extracted
-#define UNZIP_CMD "7z x -aoa -o"
-#else /* WINDOWS */
-// -o   Overwrite existing files without prompting
-// -d   The directory in which to write files.
-#define UNZIP_CMD "unzip -o -d "
+#if !WINDOWS
+#include <pthread.h>
 #endif /* WINDOWS */
+#include "zipReader.h"
 
 #define XML_FILE  "modelDescription.xml"
 #define RESULT_FILE "result.csv"
+#define RESULT_FILE_MAT "result.mat"
+#define RESULT_FILE_RAW "result.raw"
+#define TIMING_FILE "timing.json"
 #define BUFSIZE 4096
 
+// the result rows are handed to the writer thread in a ring of blocks
+#define OUTPUT_BLOCKS 4
+#define OUTPUT_BLOCK_ROWS 256
+
 #if WINDOWS
 #ifdef _WIN64
 #define DLL_DIR   "binaries\\win64\\"
@@ -49,21 +49,155 @@
 #endif /* __APPLE__ */
 #endif /* WINDOWS */
 
-// return codes of the 7z command line tool
-#define SEVEN_ZIP_NO_ERROR 0 // success
-#define SEVEN_ZIP_WARNING 1  // e.g., one or more files were locked during zip
-#define SEVEN_ZIP_ERROR 2
-#define SEVEN_ZIP_COMMAND_LINE_ERROR 7
-#define SEVEN_ZIP_OUT_OF_MEMORY 8
-#define SEVEN_ZIP_STOPPED_BY_USER 255
+// Optional settings given on the command line as --name=value, see printHelp().
+// Members are NULL if the option is not given.
+typedef struct {
+    const char *cache;          // directory of the cache of unzipped FMUs, on for the default, or off
+    const char *load;           // load the FMU binary from a file (default) or from memory
+    const char *outputFormat;   // format of the result file, e.g. mat
+    const char *outputVariables;// write only variables matching this comma separated list of patterns
+    const char *outputCausality;// write only variables with this comma separated list of causalities
+    const char *outputEvery;    // write only every n-th row
+    const char *outputPoints;   // downsample the result to this number of rows
+    const char *timing;         // report the time of the phases of the run: text or json
+} SimOptions;
+
+// Selection of the variables and rows of the result file, see createOutputFilter()
+typedef struct {
+    char **patterns;     // names of the written variables, with wildcards * and ?
+    int nPatterns;       // 0 to write variables of any name
+    Enu *causalities;    // causalities of the written variables
+    int nCausalities;    // 0 to write variables of any causality
+    int every;           // write every n-th row
+    int points;          // downsample to this number of rows, 0 to write all rows
+    double tStart;       // time range of the simulation, divided into buckets for downsampling
+    double tEnd;
+    char *buffer;        // holds the patterns
+} OutputFilter;
+
+// Formats of the result file
+typedef enum {
+    format_csv,  // text, comma-separated values
+    format_mat,  // binary MAT v4 file in the layout of Dymola results
+    format_raw   // binary, little-endian, column by column
+} OutputFormat;
+
+// Value of a column in a row block. A string is stored as the position of
+// its copy in the strings of the block.
+typedef union {
+    fmiReal real;
+    fmiInteger integer;
+    fmiBoolean boolean;
+    size_t string;
+} OutputValue;
+
+// Rows copied by the simulation loop, formatted and written by the writer thread
+typedef struct {
+    int nRows;
+    int capacity;           // OUTPUT_BLOCK_ROWS for the blocks of the ring
+    double *times;          // capacity times
+    OutputValue *values;    // capacity rows of n values
+    char *strings;          // the string values of the rows, each terminated by 0
+    size_t stringsSize;
+    size_t stringsCapacity;
+} OutputBlock;
+
+// Writes time and the non-alias variables selected by the filter to the result file
+// in one of the formats. outputRow() copies the values into the current block of a ring.
+// Full blocks are written by a background thread, so the simulation loop does no file I/O.
+// The simulation loop waits when all blocks are full.
+// Rows may be decimated or downsampled with the largest-triangle-three-buckets
+// method (LTTB) before they are copied into the ring.
+typedef struct OutputWriter OutputWriter;
+struct OutputWriter {
+    OutputFormat format;
+    FMU *fmu;
+    FILE *file;
+    int n;                      // number of columns after time
+    ScalarVariable **variables; // variable of each column
+    Elm *types;                 // type of each column, used by the writer thread
+    char separator;      // csv: separator of the columns
+    long nRows;          // number of rows written
+    int nColumns;        // mat, raw: number of numeric columns including time
+    double *row;         // mat, raw: time and the numeric values of a row
+    FILE *rows;          // raw: the rows written so far, in native byte order
+    char *names;         // raw: names of the numeric columns, each terminated by 0
+    char *text;          // csv: the formatted row
+    size_t textCapacity;
+    double tStart;       // mat: time of the first row
+    double tEnd;         // mat: time of the last row
+    long data1Pos;       // mat: file position of the matrices data_1 and data_2
+    long data2Pos;
+    // implementation of the format, return 0 on errors
+    int (*writeHeader)(OutputWriter *writer);
+    int (*writeRow)(OutputWriter *writer, double time, const OutputValue *values, const char *strings);
+    int (*finish)(OutputWriter *writer);
+    // decimation and downsampling, used by the simulation loop only
+    int every;           // write every n-th row passed to outputRow()
+    long nSamples;       // number of rows passed to outputRow()
+    int points;          // lttb: number of rows to write, 0 to write all rows
+    double lttbStart;    // lttb: start time of the first bucket
+    double lttbWidth;    // lttb: time span of a bucket
+    int lttbStarted;     // lttb: the first row has been written
+    OutputBlock lttbRows[2];  // lttb: rows of the bucket to select from and of the next bucket
+    int lttbBuckets[2];  // lttb: index of these buckets
+    double *lttbAnchor;  // lttb: time and numeric values of the row selected last
+    double *lttbMean;    // lttb: time and mean numeric values of the next bucket
+    double *lttbPoint;   // lttb: work array for the time and numeric values of a row
+    // ring of blocks, the members below are guarded by lock
+    OutputBlock blocks[OUTPUT_BLOCKS];
+    int head;            // block written next by the writer thread
+    int nQueued;         // number of full blocks from head on, the block after them is filled
+    int closing;         // no more blocks will be queued
+    int failed;          // the writer thread could not write a row
+    int threaded;        // 0 if the thread could not be started, blocks are then written in place
+#if WINDOWS
+    HANDLE thread;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE changed;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+#endif
+};
 
 void fmuLogger(fmiComponent c, fmiString instanceName, fmiStatus status, fmiString category, fmiString message, ...);
-int unzip(const char *zipPath, const char *outPath);
-void parseArguments(int argc, char *argv[], const char** fmuFileName, double* tEnd, double* h, int* loggingOn, char* csv_separator);
-void loadFMU(const char* fmuFileName);
-int checkFmiVersion(const char *xmlPath);
+// extract the model description and the binaries for this platform, if withBinaries,
+// and the resources of the FMU in zip into the directory outPath. Return 0 on errors.
+int unzip(ZipArchive *zip, const char *outPath, int withBinaries);
+void parseArguments(int argc, char *argv[], const char** fmuFileName, double* tEnd, double* h, int* loggingOn, char* csv_separator,
+                    SimOptions* options);
+// unzip and load the FMU. The FMU is unzipped to the cache in cacheDir, to a default
+// cache location if cacheDir is "on", or to a temporary directory if cacheDir is NULL or "off".
+// If load is "memory" the binary is loaded from memory and only the resources are unzipped.
+void loadFMU(const char* fmuFileName, const char *cacheDir, const char *load);
 void deleteUnzippedFiles();
-void outputRow(FMU *fmu, fmiComponent c, double time, FILE* file, char separator, fmiBoolean header);
+// return 0 if name is not a known format
+int getOutputFormat(const char *name, OutputFormat *format);
+const char *getResultFileName(OutputFormat format);
+// open the result file, write its header and start the writer thread.
+// Return NULL on errors. Caller must call closeOutputWriter(writer) if not NULL.
+OutputWriter *createOutputWriter(FMU *fmu, OutputFormat format, char separator, const OutputFilter *filter);
+// write the remaining rows, stop the writer thread, complete and close the result file.
+// Return 0 on errors.
+int closeOutputWriter(OutputWriter *writer);
+// queue time and the current values of the selected variables for writing.
+// Return 0 on errors, also if the writer thread failed to write a previous row.
+int outputRow(FMU *fmu, fmiComponent c, OutputWriter *writer, double time);
+// create the output filter from the options. Return 0 on errors.
+// Caller must call freeOutputFilter(filter) if successful.
+int createOutputFilter(const SimOptions *options, double tStart, double tEnd, OutputFilter *filter);
+void freeOutputFilter(OutputFilter *filter);
+// start timing the phases of the run if mode is text or json, see option --timing.
+// Return 0 if mode is not known.
+int startTiming(const char *mode);
+// account the time since the end of the previous phase to the phase name. The times
+// of calls with the same name add up. Does nothing if timing is off.
+void endPhase(const char *name);
+// print the times of the phases, or write them to TIMING_FILE.
+// Does nothing if timing is off. Return 0 on errors.
+int reportTiming(const char *fmuFileName);
 int error(const char* message);
 void printHelp(const char* fmusim);
 char *getTempFmuLocation(); // caller has to free the result
@@ -39,7 +39,7 @@ if defined VS80COMNTOOLS (call "%VS80COMNTOOLS%\vsvars32.bat") else ^
 goto noCompiler
 )
 
-set SRC=main.c ..\shared\sim_support.c ..\shared\xmlVersionParser.c ..\shared\parser\XmlParser.cpp ..\shared\parser\XmlElement.cpp ..\shared\parser\XmlParserCApi.cpp
+set SRC=main.c fmusim.c solver.c jacobian.c ..\shared\sim_support.c ..\shared\zipReader.c ..\shared\parser\XmlParser.cpp ..\shared\parser\XmlElement.cpp ..\shared\parser\XmlBinaryCache.cpp ..\shared\parser\XmlParserCApi.cpp
 set INC=/I..\shared\include /I..\shared /I..\shared\parser
 set OPTIONS= /nologo /EHsc /DSTANDALONE_XML_PARSER /DLIBXML_STATIC
 
@@ -0,0 +1,259 @@
+/* -------------------------------------------------------------------------
+ * fmusim.c
+ * Library functions of the simulator fmusim_cs, see fmusim.h.
+ * Simulates a FMU that implements the "FMI for Co-Simulation 2.0" interface
+ * from t = 0 .. tEnd with fixed step size h and writes the computed solution
+ * to the result file, after every step or at the points of an output grid.
+ * The steps are shortened to hit them.
+ * Copyright QTronic GmbH. All rights reserved.
+ * -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "fmusim.h"
+
+// print the message and return the status of the error
+static SimStatus fail(SimStatus status, const char *message) {
+    printf("%s\n", message);
+    return status;
+}
+
+// simulate the instance c of the given FMU from tStart = 0 to settings->tEnd
+static SimStatus simulate(FMU* fmu, fmi2Component c, const RunSettings *settings, OutputGrid *grid,
+                          OutputFormat format, OutputFilter *filter, const SimOptions *options) {
+    double tEnd = settings->tEnd;
+    double h = settings->h;
+    double time;
+    double tStart = 0;                      // start time
+    fmi2Status fmi2Flag;                    // return code of the fmu functions
+
+    ModelDescription* md;                      // handle to the parsed XML file
+    fmi2Boolean toleranceDefined = fmi2False;  // true if model description define tolerance
+    fmi2Real tolerance = 0;                    // used in setting up the experiment
+    ValueStatus vs = valueMissing;
+    int nSteps = 0;
+    double hh = h;
+    Element *defaultExp;
+    OutputPlan *plan;                          // columns of the result file
+    OutputWriter *writer;                      // writes the result file
+    SimStatus status = simOK;
+
+    md = fmu->modelDescription;
+    if (settings->nCategories > 0) {
+        fmi2Flag = fmu->setDebugLogging(c, fmi2True, settings->nCategories, settings->categories);
+        if (fmi2Flag > fmi2Warning) {
+            return fail(simModelError, "could not initialize model; failed FMI set debug logging");
+        }
+    }
+    if (!applyStartValues(fmu, c, options->startValues)) return simInvalidArgument;
+
+    defaultExp = getDefaultExperiment(md);
+    if (defaultExp) tolerance = getAttributeDouble(defaultExp, att_tolerance, &vs);
+    if (vs == valueDefined) {
+        toleranceDefined = fmi2True;
+    }
+
+    fmi2Flag = fmu->setupExperiment(c, toleranceDefined, tolerance, tStart, fmi2True, tEnd);
+    if (fmi2Flag > fmi2Warning) {
+        return fail(simModelError, "could not initialize model; failed FMI setup experiment");
+    }
+    fmi2Flag = fmu->enterInitializationMode(c);
+    if (fmi2Flag > fmi2Warning) {
+        return fail(simModelError, "could not initialize model; failed FMI enter initialization mode");
+    }
+    fmi2Flag = fmu->exitInitializationMode(c);
+    if (fmi2Flag > fmi2Warning) {
+        return fail(simModelError, "could not initialize model; failed FMI exit initialization mode");
+    }
+    endPhase("initialize");
+
+    plan = createOutputPlan(fmu, filter);
+    if (!plan) return fail(simOutOfMemory, "out of memory");
+
+    // open result file
+    if (!(writer = createOutputWriter(fmu, plan, format, options->outputFile, settings->separator, filter))) {
+        freeOutputPlan(plan);
+        return simOutputError;
+    }
+    endPhase("output");
+
+    // output solution for time t0
+    if (!outputRow(fmu, c, writer, tStart)) status = simOutputError; // output values
+
+    // enter the simulation loop
+    time = tStart;
+    while (status == simOK && time < tEnd) {
+        // check not to pass over end time
+        hh = h;
+        if (h > tEnd - time) {
+            hh = tEnd - time;
+        }
+        // do not step over the next output point, ignore round-off differences
+        if (grid->next < grid->n && grid->times[grid->next] - time < hh - 1e-9 * h) {
+            hh = grid->times[grid->next] - time;
+        }
+        fmi2Flag = fmu->doStep(c, time, hh, fmi2True);
+        if (fmi2Flag == fmi2Discard) {
+            fmi2Boolean b;
+            // check if model requests to end simulation
+            if (fmi2OK != fmu->getBooleanStatus(c, fmi2Terminated, &b)) {
+                status = fail(simModelError, "could not complete simulation of the model. getBooleanStatus return other than fmi2OK");
+            } else if (b == fmi2True) {
+                status = fail(simModelError, "the model requested to end the simulation");
+            } else {
+                status = fail(simModelError, "could not complete simulation of the model");
+            }
+            break;
+        }
+        if (fmi2Flag != fmi2OK) {
+            status = fail(simModelError, "could not complete simulation of the model");
+            break;
+        }
+        time += hh;
+        if (grid->n == 0) {
+            if (!outputRow(fmu, c, writer, time)) status = simOutputError; // output values for this step
+        } else if (grid->next < grid->n && grid->times[grid->next] <= time + 1e-9 * h) {
+            time = grid->times[grid->next];
+            while (grid->next < grid->n && grid->times[grid->next] <= time) grid->next++;
+            if (!outputRow(fmu, c, writer, time)) status = simOutputError; // output values for this grid point
+        }
+        nSteps++;
+    }
+    endPhase("simulate");
+
+    // end simulation, the instance is reset by the next run
+    if (status == simOK) fmu->terminate(c);
+    if (!closeOutputWriter(writer) && status == simOK) status = simOutputError;
+    freeOutputPlan(plan);
+    endPhase("terminate");
+    if (status != simOK) return status;
+
+    // print simulation summary
+    printf("Simulation from %g to %g terminated successful\n", tStart, tEnd);
+    printf("  steps ............ %d\n", nSteps);
+    printf("  fixed step size .. %g\n", h);
+    return simOK;
+}
+
+// print the name of the written result file
+static void printResultFile(OutputFormat format, const char *fileName) {
+    if (!fileName) fileName = getResultFileName(format);
+    if (format == format_csv) {
+        printf("CSV file '%s' written\n", fileName);
+    } else {
+        printf("Result file '%s' written\n", fileName);
+    }
+}
+
+// get the format and create the output grid and filter of a run from its options.
+// Caller must free grid and filter if successful.
+static SimStatus prepareRun(const RunSettings *settings, const SimOptions *options, OutputFormat *format,
+                            OutputGrid *grid, OutputFilter *filter) {
+    *format = format_csv;
+    if (options->outputFormat && !getOutputFormat(options->outputFormat, format)) {
+        printf("error: The given output format (%s) is not known\n", options->outputFormat);
+        return simInvalidArgument;
+    }
+    // the simulation starts at t = 0
+    if (!createOutputGrid(options, 0, settings->tEnd, grid)) return simInvalidArgument;
+    if (!createOutputFilter(options, 0, settings->tEnd, filter)) {
+        freeOutputGrid(grid);
+        return simInvalidArgument;
+    }
+    return simOK;
+}
+
+SimStatus loadSimulation(const char *fmuFileName, const char *cacheDir, const char *load, Simulation **sim) {
+    Simulation *s = (Simulation *)calloc(1, sizeof(Simulation));
+    *sim = NULL;
+    if (!s) return fail(simOutOfMemory, "out of memory");
+    if (!loadFMU(&s->fmu, fmuFileName, cacheDir, load)) {
+        free(s);
+        return simLoadError;
+    }
+    {
+        // called by the model, the logger finds the FMU in its environment
+        fmi2CallbackFunctions callbacks = {fmuLogger, calloc, free, NULL, &s->fmu};
+        memcpy(&s->callbacks, &callbacks, sizeof(callbacks));
+    }
+    *sim = s;
+    return simOK;
+}
+
+SimStatus instantiateSimulation(Simulation *sim, fmi2Boolean loggingOn) {
+    ModelDescription *md = sim->fmu.modelDescription;
+    const char *guid;                 // global unique id of the fmu
+    const char *instanceName;         // instance name
+    char *fmuResourceLocation;        // path to the fmu resources as URL, "file://C:\QTronic\sales"
+    fmi2Boolean visible = fmi2False;  // no simulator user interface
+
+    if (sim->c) return simOK;
+    guid = getAttributeValue((Element *)md, att_guid);
+    instanceName = getAttributeValue((Element *)getCoSimulation(md), att_modelIdentifier);
+    fmuResourceLocation = getTempResourcesLocation(&sim->fmu);
+    sim->c = sim->fmu.instantiate(instanceName, fmi2CoSimulation, guid, fmuResourceLocation,
+                                  &sim->callbacks, visible, loggingOn);
+    free(fmuResourceLocation);
+    if (!sim->c) return fail(simInstantiateError, "could not instantiate model");
+    sim->fresh = 1;
+    return simOK;
+}
+
+SimStatus checkRunSettings(const RunSettings *settings) {
+    SimOptions noOptions = { NULL };
+    OutputFormat format;
+    OutputGrid grid;
+    OutputFilter filter;
+    SimStatus status = prepareRun(settings, settings->options ? settings->options : &noOptions,
+                                  &format, &grid, &filter);
+    if (status != simOK) return status;
+    freeOutputGrid(&grid);
+    freeOutputFilter(&filter);
+    return simOK;
+}
+
+SimStatus runSimulation(Simulation *sim, const RunSettings *settings) {
+    SimOptions noOptions = { NULL };
+    const SimOptions *options = settings->options ? settings->options : &noOptions;
+    OutputFormat format;
+    OutputGrid grid;
+    OutputFilter filter;
+    SimStatus status = prepareRun(settings, options, &format, &grid, &filter);
+    if (status != simOK) return status;
+
+    // reset the instance of the previous run, instantiate the fmu again if that fails
+    if (sim->c && !sim->fresh && sim->fmu.reset(sim->c) > fmi2Warning) {
+        sim->fmu.freeInstance(sim->c);
+        sim->c = NULL;
+    }
+    status = instantiateSimulation(sim, settings->loggingOn);
+    sim->fresh = 0;
+    endPhase("instantiate");
+
+    if (status == simOK) status = simulate(&sim->fmu, sim->c, settings, &grid, format, &filter, options);
+    if (status == simOK) printResultFile(format, options->outputFile);
+    freeOutputGrid(&grid);
+    freeOutputFilter(&filter);
+    return status;
+}
+
+void freeSimulation(Simulation *sim) {
+    if (!sim) return;
+    if (sim->c) sim->fmu.freeInstance(sim->c);
+    unloadFMU(&sim->fmu);
+    free(sim);
+}
+
+const char *getSimStatusName(SimStatus status) {
+    switch (status) {
+        case simOK:               return "ok";
+        case simInvalidArgument:  return "invalid argument";
+        case simLoadError:        return "load error";
+        case simInstantiateError: return "instantiate error";
+        case simModelError:       return "model error";
+        case simOutputError:      return "output error";
+        case simOutOfMemory:      return "out of memory";
+        default:                  return "?";
+    }
+}
@@ -0,0 +1,488 @@
+/* -------------------------------------------------------------------------
+ * fmusim.c
+ * Library functions of the simulator fmusim_me, see fmusim.h.
+ * Simulates a FMU that implements the "FMI for Model Exchange 2.0" interface
+ * from t = 0 .. tEnd using the forward Euler method with fixed step size h,
+ * or an adaptive Runge-Kutta or implicit BDF method with maximum step size h,
+ * and writes the computed solution to the result file, after every step or
+ * interpolated at the points of an output grid.
+ * Copyright QTronic GmbH. All rights reserved.
+ * -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "fmusim.h"
+#include "solver.h"
+
+// print the message and return the status of the error
+static SimStatus fail(SimStatus status, const char *message) {
+    printf("%s\n", message);
+    return status;
+}
+
+// free the work arrays of simulate(), each may be NULL
+static void freeStates(double *z, double *prez, double *x, double *xTime) {
+    free(z);
+    free(prez);
+    free(x);
+    free(xTime);
+}
+
+// write the points of the output grid up to time, using the interpolated states of the
+// last step. x is a work array. The fmu is set back to time and the states xTime.
+static int outputGridPoints(FMU *fmu, fmi2Component c, Solver *solver, OutputGrid *grid, double time,
+                            double *x, double *xTime, OutputWriter *writer) {
+    fmi2Status fmi2Flag;
+    int nx = solver->nx;
+    if (grid->next >= grid->n || grid->times[grid->next] > time) return 1;
+
+    fmi2Flag = fmu->getContinuousStates(c, xTime, nx);
+    if (fmi2Flag > fmi2Warning) return error("could not retrieve states");
+    while (grid->next < grid->n && grid->times[grid->next] <= time) {
+        double t = grid->times[grid->next++];
+        const double *xt = xTime;
+        if (t < time) {
+            solverInterpolate(solver, t, x);
+            xt = x;
+        }
+        fmi2Flag = fmu->setTime(c, t);
+        if (fmi2Flag > fmi2Warning) return error("could not set time");
+        fmi2Flag = fmu->setContinuousStates(c, xt, nx);
+        if (fmi2Flag > fmi2Warning) return error("could not set states");
+        if (!outputRow(fmu, c, writer, t)) return 0;
+    }
+    fmi2Flag = fmu->setTime(c, time);
+    if (fmi2Flag > fmi2Warning) return error("could not set time");
+    fmi2Flag = fmu->setContinuousStates(c, xTime, nx);
+    if (fmi2Flag > fmi2Warning) return error("could not set states");
+    return 1;
+}
+
+// simulate the given FMU using the given integration method.
+// time events are processed by reducing step size to exactly hit tNext.
+// state events are found by checking the event indicators for sign changes at the end
+// and at interior points of an integrator step, using the interpolated states, and then
+// located in time by root finding on the event indicators.
+// the simulator may miss state events if an indicator changes sign twice within a small
+// part of a step.
+// c is the instance of the given FMU, the simulation runs from tStart = 0 to settings->tEnd.
+static SimStatus simulate(FMU* fmu, fmi2Component c, const RunSettings *settings, SolverMethod method,
+                          OutputGrid *grid, OutputFormat format, OutputFilter *filter, const SimOptions *options) {
+    double tEnd = settings->tEnd;
+    double h = settings->h;
+    fmi2Boolean loggingOn = settings->loggingOn;
+    int i;
+    double tMax;
+    fmi2Boolean timeEvent, stateEvent, stepEvent, terminateSimulation;
+    double time;
+    int nx;                          // number of state variables
+    int nz;                          // number of state event indicators
+    Solver *solver;                  // integrates the continuous states
+    double *z = NULL;                // state event indicators
+    double *prez = NULL;             // previous values of state event indicators
+    double *x = NULL;                // interpolated states at output grid points
+    double *xTime = NULL;            // states at the end of a step
+    fmi2EventInfo eventInfo;         // updated by calls to initialize and eventUpdate
+    ModelDescription* md;            // handle to the parsed XML file
+    fmi2Status fmi2Flag;             // return code of the fmu functions
+    fmi2Real tStart = 0;             // start time
+    fmi2Boolean toleranceDefined = fmi2False; // true if model description define tolerance
+    fmi2Real tolerance = 0;          // used in setting up the experiment
+    int nSteps = 0;
+    int nTimeEvents = 0;
+    int nStepEvents = 0;
+    int nStateEvents = 0;
+    OutputPlan *plan;                // columns of the result file
+    OutputWriter *writer;            // writes the result file
+    ValueStatus vs;
+    Element *defaultExp;
+    int ok = 1;
+    SimStatus status = simModelError; // of the run if not ok
+
+    md = fmu->modelDescription;
+    if (settings->nCategories > 0) {
+        fmi2Flag = fmu->setDebugLogging(c, fmi2True, settings->nCategories, settings->categories);
+        if (fmi2Flag > fmi2Warning) {
+            return fail(simModelError, "could not initialize model; failed FMI set debug logging");
+        }
+    }
+    if (!applyStartValues(fmu, c, options->startValues)) return simInvalidArgument;
+
+    // allocate memory
+    nx = getDerivativesSize(getModelStructure(md)); // number of continuous states is number of derivatives
+                                                    // declared in model structure
+    nz = getAttributeInt((Element *)md, att_numberOfEventIndicators, &vs); // number of event indicators
+    if (nz>0) {
+        z    =  (double *) calloc(nz, sizeof(double));
+        prez =  (double *) calloc(nz, sizeof(double));
+    }
+    if (grid->n > 0) {
+        x     = (double *) calloc(nx + 1, sizeof(double));
+        xTime = (double *) calloc(nx + 1, sizeof(double));
+    }
+    if ((nz>0 && (!z || !prez)) || (grid->n > 0 && (!x || !xTime))) {
+        freeStates(z, prez, x, xTime);
+        return fail(simOutOfMemory, "out of memory");
+    }
+
+    // the tolerance of the default experiment controls the error of adaptive methods
+    defaultExp = getDefaultExperiment(md);
+    vs = valueMissing;
+    if (defaultExp) tolerance = getAttributeDouble(defaultExp, att_tolerance, &vs);
+    if (vs == valueDefined && tolerance > 0) {
+        toleranceDefined = fmi2True;
+    } else {
+        tolerance = DEFAULT_TOLERANCE;
+    }
+    solver = createSolver(method, fmu, c, nx, h, tolerance);
+    if (!solver) {
+        freeStates(z, prez, x, xTime);
+        return fail(simOutOfMemory, "out of memory");
+    }
+    plan = createOutputPlan(fmu, filter);
+    if (!plan) {
+        freeSolver(solver);
+        freeStates(z, prez, x, xTime);
+        return fail(simOutOfMemory, "out of memory");
+    }
+
+    // open result file
+    if (!(writer = createOutputWriter(fmu, plan, format, options->outputFile, settings->separator, filter))) {
+        freeSolver(solver);
+        freeOutputPlan(plan);
+        freeStates(z, prez, x, xTime);
+        return simOutputError;
+    }
+    endPhase("output");
+
+    // setup the experiment, set the start time
+    time = tStart;
+    fmi2Flag = fmu->setupExperiment(c, toleranceDefined, tolerance, tStart, fmi2True, tEnd);
+    if (fmi2Flag > fmi2Warning) {
+        ok = error("could not initialize model; failed FMI setup experiment");
+    }
+
+    // initialize
+    if (ok) {
+        fmi2Flag = fmu->enterInitializationMode(c);
+        if (fmi2Flag > fmi2Warning) {
+            ok = error("could not initialize model; failed FMI enter initialization mode");
+        }
+    }
+    if (ok) {
+        fmi2Flag = fmu->exitInitializationMode(c);
+        if (fmi2Flag > fmi2Warning) {
+            ok = error("could not initialize model; failed FMI exit initialization mode");
+        }
+    }
+
+    // event iteration
+    eventInfo.newDiscreteStatesNeeded = fmi2True;
+    eventInfo.terminateSimulation = fmi2False;
+    while (ok && eventInfo.newDiscreteStatesNeeded && !eventInfo.terminateSimulation) {
+        // update discrete states
+        fmi2Flag = fmu->newDiscreteStates(c, &eventInfo);
+        if (fmi2Flag > fmi2Warning) ok = error("could not set a new discrete state");
+    }
+    endPhase("initialize");
+
+    if (ok && eventInfo.terminateSimulation) {
+        printf("model requested termination at t=%.16g\n", time);
+    } else if (ok) {
+        // enter Continuous-Time Mode
+        fmu->enterContinuousTimeMode(c);
+        // output solution for time tStart
+        if (!outputRow(fmu, c, writer, tStart)) { // output values
+            ok = 0;
+            status = simOutputError;
+        }
+
+        // enter the simulation loop
+        ok = ok && solverReset(solver, time);
+        if (ok) {
+            fmi2Flag = fmu->getEventIndicators(c, z, nz);
+            if (fmi2Flag > fmi2Warning) ok = error("could not retrieve event indicators");
+        }
+        while (ok && time < tEnd) {
+            // advance time, but stop at the next time event
+            tMax = tEnd;
+            if (eventInfo.nextEventTimeDefined && eventInfo.nextEventTime < tEnd) {
+                tMax = eventInfo.nextEventTime;
+            }
+
+            // perform one step, this sets time and states of the fmu
+            if (!solverStep(solver, tMax)) {
+                ok = error("could not perform integrator step");
+                break;
+            }
+            time = solver->t;
+            if (loggingOn) printf("Step %d to t=%.16g\n", nSteps, time);
+
+            // check for state event
+            for (i = 0; i < nz; i++) prez[i] = z[i];
+            fmi2Flag = fmu->getEventIndicators(c, z, nz);
+            if (fmi2Flag > fmi2Warning) {
+                ok = error("could not retrieve event indicators");
+                break;
+            }
+
+            // find and locate a state event inside the step, this sets time and states of the fmu
+            stateEvent = FALSE;
+            if (nz > 0 && !solverLocateEvent(solver, nz, prez, z, &stateEvent, &time)) {
+                ok = 0;
+                break;
+            }
+            if (stateEvent && loggingOn) printf("state event located at t=%.16g\n", time);
+            timeEvent = tMax < tEnd && time >= tMax;
+
+            // output the grid points up to time, before the event is handled
+            if (!outputGridPoints(fmu, c, solver, grid, time, x, xTime, writer)) {
+                ok = 0;
+                break;
+            }
+
+            // check for step event, e.g. dynamic state selection
+            fmi2Flag = fmu->completedIntegratorStep(c, fmi2True, &stepEvent, &terminateSimulation);
+            if (fmi2Flag > fmi2Warning) {
+                ok = error("could not complete intgrator step");
+                break;
+            }
+            if (terminateSimulation) {
+                printf("model requested termination at t=%.16g\n", time);
+                break; // success
+            }
+
+            // handle events
+            if (timeEvent || stateEvent || stepEvent) {
+                fmu->enterEventMode(c);
+                if (timeEvent) {
+                    nTimeEvents++;
+                    if (loggingOn) printf("time event at t=%.16g\n", time);
+                }
+                if (stateEvent) {
+                    nStateEvents++;
+                    if (loggingOn) for (i=0; i<nz; i++)
+                        printf("state event %s z[%d] at t=%.16g\n",
+                               (prez[i]>0 && z[i]<0) ? "-\\-" : "-/-", i, time);
+                }
+                if (stepEvent) {
+                    nStepEvents++;
+                    if (loggingOn) printf("step event at t=%.16g\n", time);
+                }
+
+                // event iteration in one step, ignoring intermediate results
+                eventInfo.newDiscreteStatesNeeded = fmi2True;
+                eventInfo.terminateSimulation = fmi2False;
+                while (eventInfo.newDiscreteStatesNeeded && !eventInfo.terminateSimulation) {
+                    // update discrete states
+                    fmi2Flag = fmu->newDiscreteStates(c, &eventInfo);
+                    if (fmi2Flag > fmi2Warning) {
+                        ok = error("could not set a new discrete state");
+                        break;
+                    }
+
+                    // check for change of value of states
+                    if (eventInfo.valuesOfContinuousStatesChanged && loggingOn) {
+                        printf("continuous state values changed at t=%.16g\n", time);
+                    }
+                    if (eventInfo.nominalsOfContinuousStatesChanged && loggingOn){
+                        printf("nominals of continuous state changed  at t=%.16g\n", time);
+                    }
+                }
+                if (!ok) break;
+                if (eventInfo.terminateSimulation) {
+                    printf("model requested termination at t=%.16g\n", time);
+                    break; // success
+                }
+
+                // enter Continuous-Time Mode
+                fmu->enterContinuousTimeMode(c);
+
+                // restart the integration from the states after the event
+                if (!solverReset(solver, time)) {
+                    ok = 0;
+                    break;
+                }
+                fmi2Flag = fmu->getEventIndicators(c, z, nz);
+                if (fmi2Flag > fmi2Warning) {
+                    ok = error("could not retrieve event indicators");
+                    break;
+                }
+            } // if event
+            // output values for this step
+            if (grid->n == 0 && !outputRow(fmu, c, writer, time)) {
+                ok = 0;
+                status = simOutputError;
+                break;
+            }
+            nSteps++;
+        } // while
+    }
+    endPhase("simulate");
+    // cleanup, the instance is reset by the next run
+    if (ok) fmu->terminate(c);
+    if (!closeOutputWriter(writer) && ok) {
+        ok = 0;
+        status = simOutputError;
+    }
+    freeOutputPlan(plan);
+    endPhase("terminate");
+    freeStates(z, prez, x, xTime);
+    if (!ok) {
+        freeSolver(solver);
+        return status;
+    }
+
+    // print simulation summary
+    printf("Simulation from %g to %g terminated successful\n", tStart, tEnd);
+    printf("  steps ............ %d\n", nSteps);
+    if (method == solver_euler) {
+        printf("  fixed step size .. %g\n", h);
+    } else {
+        printf("  solver ........... %s\n", getSolverMethodName(method));
+        printf("  tolerance ........ %g\n", tolerance);
+        printf("  rejected steps ... %d\n", solver->nRejected);
+        printf("  derivative calls . %d\n", solver->nRhs);
+        if (method == solver_bdf) {
+            printf("  Jacobians ........ %d (%d colors%s)\n", solver->nJacobians, solver->pattern->nColors,
+                   solver->useDirectionalDerivative ? ", directional derivatives" : "");
+            printf("  LU decompositions  %d\n", solver->nLU);
+        }
+    }
+    printf("  time events ...... %d\n", nTimeEvents);
+    printf("  state events ..... %d\n", nStateEvents);
+    printf("  step events ...... %d\n", nStepEvents);
+    freeSolver(solver);
+
+    return simOK;
+}
+
+// print the name of the written result file
+static void printResultFile(OutputFormat format, const char *fileName) {
+    if (!fileName) fileName = getResultFileName(format);
+    if (format == format_csv) {
+        printf("CSV file '%s' written\n", fileName);
+    } else {
+        printf("Result file '%s' written\n", fileName);
+    }
+}
+
+// get the integration method and format and create the output grid and filter of a run
+// from its options. Caller must free grid and filter if successful.
+static SimStatus prepareRun(const RunSettings *settings, const SimOptions *options, SolverMethod *method,
+                            OutputFormat *format, OutputGrid *grid, OutputFilter *filter) {
+    *method = solver_euler;
+    if (options->solver && !getSolverMethod(options->solver, method)) {
+        printf("error: The given solver (%s) is not known\n", options->solver);
+        return simInvalidArgument;
+    }
+    *format = format_csv;
+    if (options->outputFormat && !getOutputFormat(options->outputFormat, format)) {
+        printf("error: The given output format (%s) is not known\n", options->outputFormat);
+        return simInvalidArgument;
+    }
+    // the simulation starts at t = 0
+    if (!createOutputGrid(options, 0, settings->tEnd, grid)) return simInvalidArgument;
+    if (!createOutputFilter(options, 0, settings->tEnd, filter)) {
+        freeOutputGrid(grid);
+        return simInvalidArgument;
+    }
+    return simOK;
+}
+
+SimStatus loadSimulation(const char *fmuFileName, const char *cacheDir, const char *load, Simulation **sim) {
+    Simulation *s = (Simulation *)calloc(1, sizeof(Simulation));
+    *sim = NULL;
+    if (!s) return fail(simOutOfMemory, "out of memory");
+    if (!loadFMU(&s->fmu, fmuFileName, cacheDir, load)) {
+        free(s);
+        return simLoadError;
+    }
+    {
+        // called by the model, the logger finds the FMU in its environment
+        fmi2CallbackFunctions callbacks = {fmuLogger, calloc, free, NULL, &s->fmu};
+        memcpy(&s->callbacks, &callbacks, sizeof(callbacks));
+    }
+    *sim = s;
+    return simOK;
+}
+
+SimStatus instantiateSimulation(Simulation *sim, fmi2Boolean loggingOn) {
+    ModelDescription *md = sim->fmu.modelDescription;
+    const char *guid;                 // global unique id of the fmu
+    const char *instanceName;         // instance name
+    char *fmuResourceLocation;        // path to the fmu resources as URL, "file://C:\QTronic\sales"
+    fmi2Boolean visible = fmi2False;  // no simulator user interface
+
+    if (sim->c) return simOK;
+    guid = getAttributeValue((Element *)md, att_guid);
+    instanceName = getAttributeValue((Element *)getModelExchange(md), att_modelIdentifier);
+    fmuResourceLocation = getTempResourcesLocation(&sim->fmu);
+    sim->c = sim->fmu.instantiate(instanceName, fmi2ModelExchange, guid, fmuResourceLocation,
+                                  &sim->callbacks, visible, loggingOn);
+    free(fmuResourceLocation);
+    if (!sim->c) return fail(simInstantiateError, "could not instantiate model");
+    sim->fresh = 1;
+    return simOK;
+}
+
+SimStatus checkRunSettings(const RunSettings *settings) {
+    SimOptions noOptions = { NULL };
+    SolverMethod method;
+    OutputFormat format;
+    OutputGrid grid;
+    OutputFilter filter;
+    SimStatus status = prepareRun(settings, settings->options ? settings->options : &noOptions,
+                                  &method, &format, &grid, &filter);
+    if (status != simOK) return status;
+    freeOutputGrid(&grid);
+    freeOutputFilter(&filter);
+    return simOK;
+}
+
+SimStatus runSimulation(Simulation *sim, const RunSettings *settings) {
+    SimOptions noOptions = { NULL };
+    const SimOptions *options = settings->options ? settings->options : &noOptions;
+    SolverMethod method;
+    OutputFormat format;
+    OutputGrid grid;
+    OutputFilter filter;
+    SimStatus status = prepareRun(settings, options, &method, &format, &grid, &filter);
+    if (status != simOK) return status;
+
+    // reset the instance of the previous run, instantiate the fmu again if that fails
+    if (sim->c && !sim->fresh && sim->fmu.reset(sim->c) > fmi2Warning) {
+        sim->fmu.freeInstance(sim->c);
+        sim->c = NULL;
+    }
+    status = instantiateSimulation(sim, settings->loggingOn);
+    sim->fresh = 0;
+    endPhase("instantiate");
+
+    if (status == simOK) status = simulate(&sim->fmu, sim->c, settings, method, &grid, format, &filter, options);
+    if (status == simOK) printResultFile(format, options->outputFile);
+    freeOutputGrid(&grid);
+    freeOutputFilter(&filter);
+    return status;
+}
+
+void freeSimulation(Simulation *sim) {
+    if (!sim) return;
+    if (sim->c) sim->fmu.freeInstance(sim->c);
+    unloadFMU(&sim->fmu);
+    free(sim);
+}
+
+const char *getSimStatusName(SimStatus status) {
+    switch (status) {
+        case simOK:               return "ok";
+        case simInvalidArgument:  return "invalid argument";
+        case simLoadError:        return "load error";
+        case simInstantiateError: return "instantiate error";
+        case simModelError:       return "model error";
+        case simOutputError:      return "output error";
+        case simOutOfMemory:      return "out of memory";
+        default:                  return "?";
+    }
+}
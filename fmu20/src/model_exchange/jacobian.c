@@ -0,0 +1,147 @@
+/* -------------------------------------------------------------------------
+ * jacobian.c
+ * Sparsity pattern and column coloring of the Jacobian df/dx.
+ * The order of the derivatives in the ModelStructure defines the order of
+ * the continuous states. The dependencies attribute of derivative i lists
+ * the indices of the variables der(x[i]) depends on; those that are states
+ * give the nonzeros of row i. Inputs and other variables are ignored.
+ * The columns are colored greedily in their natural order, see Coleman,
+ * More: Estimation of sparse Jacobian matrices and graph coloring problems,
+ * SIAM J. Numer. Anal. 20(1), 1983.
+ * Copyright QTronic GmbH. All rights reserved.
+ * -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include "fmi2.h"
+#include "jacobian.h"
+
+// map the index of each ScalarVariable to the position of the state it is,
+// -1 if not a state. Return NULL if out of memory or the states are not found.
+static int *getStatePositions(ModelDescription *md, int nx) {
+    int i, index;
+    ValueStatus vs;
+    ModelStructure *ms = getModelStructure(md);
+    int nSv = getScalarVariableSize(md);
+    int *positions;
+
+    if (!ms || getDerivativesSize(ms) != nx) return NULL;
+    positions = (int *)malloc((nSv + 1) * sizeof(int));
+    if (!positions) return NULL;
+    for (i = 0; i < nSv; i++) positions[i] = -1;
+    for (i = 0; i < nx; i++) {
+        index = getAttributeInt(getDerivative(ms, i), att_index, &vs);
+        if (vs == valueDefined && index >= 1 && index <= nSv) {
+            index = getAttributeInt(getTypeSpec(getScalarVariable(md, index - 1)), att_derivative, &vs);
+        }
+        if (vs != valueDefined || index < 1 || index > nSv) {
+            free(positions);
+            return NULL;
+        }
+        positions[index - 1] = i;
+    }
+    return positions;
+}
+
+// compute in cols the columns of the nonzeros of row i, return their number.
+// used is a work array of nx zeros.
+static int getRow(ModelDescription *md, int i, int nx, const int *positions, char *used, int *cols) {
+    int j, index, n = 0;
+    int nSv = getScalarVariableSize(md);
+    const char *deps = positions ? getAttributeValue(getDerivative(getModelStructure(md), i), att_dependencies) : NULL;
+    char *end;
+
+    if (!deps) {
+        // depends on all states
+        for (j = 0; j < nx; j++) cols[j] = j;
+        return nx;
+    }
+    for (;;) {
+        index = (int)strtol(deps, &end, 10);
+        if (end == deps) break;
+        deps = end;
+        if (index >= 1 && index <= nSv) {
+            j = positions[index - 1];
+            if (j >= 0 && !used[j]) {
+                used[j] = 1;
+                cols[n++] = j;
+            }
+        }
+    }
+    for (j = 0; j < n; j++) used[cols[j]] = 0;
+    return n;
+}
+
+JacobianPattern *createJacobianPattern(ModelDescription *md, int nx) {
+    int i, j, k, l, n, nnz;
+    int *positions = getStatePositions(md, nx);
+    int *rowStart = (int *)calloc(nx + 1, sizeof(int));
+    int *cols = (int *)calloc(nx + 1, sizeof(int));
+    int *forbidden = (int *)calloc(nx + 1, sizeof(int));
+    char *used = (char *)calloc(nx + 1, sizeof(char));
+    int *colIndex = NULL;
+    JacobianPattern *p = (JacobianPattern *)calloc(1, sizeof(JacobianPattern));
+    int ok = rowStart && cols && forbidden && used && p;
+
+    // rows: count the nonzeros first, then store the columns
+    for (i = 0, nnz = 0; ok && i < nx; i++) {
+        rowStart[i] = nnz;
+        nnz += getRow(md, i, nx, positions, used, cols);
+    }
+    if (ok) {
+        rowStart[nx] = nnz;
+        colIndex = (int *)malloc((nnz + 1) * sizeof(int));
+        p->colStart = (int *)calloc(nx + 1, sizeof(int));
+        p->rowIndex = (int *)malloc((nnz + 1) * sizeof(int));
+        p->colors = (int *)malloc((nx + 1) * sizeof(int));
+        ok = colIndex && p->colStart && p->rowIndex && p->colors;
+    }
+    if (ok) {
+        p->nx = nx;
+        p->nnz = nnz;
+        for (i = 0; i < nx; i++) getRow(md, i, nx, positions, used, colIndex + rowStart[i]);
+
+        // columns: transpose the rows
+        for (k = 0; k < nnz; k++) p->colStart[colIndex[k] + 1]++;
+        for (j = 0; j < nx; j++) p->colStart[j + 1] += p->colStart[j];
+        for (j = 0; j < nx; j++) cols[j] = p->colStart[j];
+        for (i = 0; i < nx; i++) {
+            for (k = rowStart[i]; k < rowStart[i + 1]; k++) p->rowIndex[cols[colIndex[k]]++] = i;
+        }
+
+        // greedy coloring: give column j the smallest color not used by a column
+        // that has a nonzero in a common row
+        for (j = 0; j < nx; j++) forbidden[j] = -1;
+        p->nColors = 0;
+        for (j = 0; j < nx; j++) {
+            for (k = p->colStart[j]; k < p->colStart[j + 1]; k++) {
+                i = p->rowIndex[k];
+                for (l = rowStart[i]; l < rowStart[i + 1]; l++) {
+                    n = colIndex[l];
+                    if (n < j) forbidden[p->colors[n]] = j;
+                }
+            }
+            for (n = 0; forbidden[n] == j; n++);
+            p->colors[j] = n;
+            if (n >= p->nColors) p->nColors = n + 1;
+        }
+    }
+    free(positions);
+    free(rowStart);
+    free(cols);
+    free(forbidden);
+    free(used);
+    free(colIndex);
+    if (!ok) {
+        freeJacobianPattern(p);
+        return NULL;
+    }
+    return p;
+}
+
+void freeJacobianPattern(JacobianPattern *p) {
+    if (!p) return;
+    free(p->colStart);
+    free(p->rowIndex);
+    free(p->colors);
+    free(p);
+}
@@ -0,0 +1,31 @@
+/* -------------------------------------------------------------------------
+ * jacobian.h
+ * Sparsity pattern of the Jacobian df/dx of a FMI 2.0 Model Exchange FMU,
+ * built from the dependencies of the derivatives in the ModelStructure,
+ * and a column coloring to compute it with few derivative evaluations.
+ * Copyright QTronic GmbH. All rights reserved.
+ * -------------------------------------------------------------------------*/
+
+#ifndef JACOBIAN_H
+#define JACOBIAN_H
+
+#include "fmi2.h"
+
+// Columns of the same color have no nonzero in a common row. They are
+// computed together by one directional derivative or finite difference
+// with the sum of the columns as seed (Curtis, Powell, Reid 1974).
+typedef struct {
+    int nx;         // number of continuous states, size of the Jacobian
+    int nnz;        // number of structural nonzeros
+    int *colStart;  // rows of column j are rowIndex[colStart[j] .. colStart[j+1]-1]
+    int *rowIndex;
+    int nColors;    // number of colors, at most nx
+    int *colors;    // color of each column, 0 .. nColors-1
+} JacobianPattern;
+
+// Derivatives without dependencies attribute depend on all states.
+// Return NULL if out of memory. Caller must call freeJacobianPattern(p) if not NULL.
+JacobianPattern *createJacobianPattern(ModelDescription *md, int nx);
+void freeJacobianPattern(JacobianPattern *p);
+
+#endif // JACOBIAN_H
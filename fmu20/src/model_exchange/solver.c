@@ -0,0 +1,915 @@
+/* -------------------------------------------------------------------------
+ * solver.c
+ * Numerical integration methods used by fmusim_me:
+ *  - euler: forward Euler with fixed step size h
+ *  - rk45:  explicit Runge-Kutta pair of Dormand and Prince, order 5(4),
+ *           with local error control and step size adaptation. The error
+ *           is measured relative to the tolerance of the DefaultExperiment,
+ *           scaled by the nominal values of the continuous states.
+ *           The continuous extension of order 4 is used for dense output.
+ *           See Hairer, Norsett, Wanner: Solving Ordinary Differential
+ *           Equations I, Section II.5 and II.6.
+ *  - bdf:   implicit backward differentiation formulas of order 1 to 5 in
+ *           the quasi-constant step size form of Shampine and Reichelt,
+ *           The MATLAB ODE Suite, SIAM J. Sci. Comput. 18(1), 1997, with
+ *           adaptive step size and order, for stiff models. The implicit
+ *           equations are solved with a modified Newton iteration: the
+ *           Jacobian and the LU decomposition of the iteration matrix are
+ *           reused across steps and only updated if the iteration fails to
+ *           converge or the step size or order changes. The Jacobian is
+ *           computed with fmi2GetDirectionalDerivative if the FMU provides
+ *           directional derivatives, otherwise by finite differences, one
+ *           evaluation per color of the columns, see jacobian.c.
+ * Copyright QTronic GmbH. All rights reserved.
+ * -------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "fmi2.h"
+#include "sim_support.h"
+#include "solver.h"
+
+// Butcher tableau of the Dormand-Prince method. The last row of a equals
+// the weights b of the 5th order solution (FSAL: first same as last).
+static const double c_[7] = { 0.0, 1.0/5, 3.0/10, 4.0/5, 8.0/9, 1.0, 1.0 };
+static const double a_[7][6] = {
+    { 0 },
+    { 1.0/5 },
+    { 3.0/40, 9.0/40 },
+    { 44.0/45, -56.0/15, 32.0/9 },
+    { 19372.0/6561, -25360.0/2187, 64448.0/6561, -212.0/729 },
+    { 9017.0/3168, -355.0/33, 46732.0/5247, 49.0/176, -5103.0/18656 },
+    { 35.0/384, 0.0, 500.0/1113, 125.0/192, -2187.0/6784, 11.0/84 }
+};
+// difference between the 5th and the embedded 4th order solution
+static const double e_[7] = {
+    71.0/57600, 0.0, -71.0/16695, 71.0/1920, -17253.0/339200, 22.0/525, -1.0/40
+};
+// coefficients of the continuous extension
+static const double d_[7] = {
+    -12715105075.0/11282082432, 0.0, 87487479700.0/32700410799, -10690763975.0/1880347072,
+    701980252875.0/199316789632, -1453857185.0/822651844, 69997945.0/29380423
+};
+
+// number of parts of a step at whose ends the event indicators are checked for a
+// sign change, such that an indicator that crosses zero and back within a step is found
+#define EVENT_SAMPLES 8
+
+#define SAFETY     0.9
+#define MIN_FACTOR 0.2
+#define MAX_FACTOR 5.0
+
+// BDF: maximum number of Newton iterations per step and limits of step size changes
+#define BDF_NEWTON_MAXITER 4
+#define BDF_MIN_FACTOR 0.2
+#define BDF_MAX_FACTOR 10.0
+
+// BDF coefficients, index is the order: gamma[k] = sum(1/j, j = 1..k)
+// and the error constants 1/(k+1) of the local truncation error
+static const double gamma_[BDF_MAX_ORDER + 2] = {
+    0.0, 1.0, 3.0/2, 11.0/6, 25.0/12, 137.0/60, 49.0/20
+};
+static const double errorConst_[BDF_MAX_ORDER + 2] = {
+    1.0, 1.0/2, 1.0/3, 1.0/4, 1.0/5, 1.0/6, 1.0/7
+};
+
+static const char *methodNames[] = { "euler", "rk45", "bdf" };
+
+int getSolverMethod(const char *name, SolverMethod *method) {
+    int i;
+    for (i = 0; i < (int)(sizeof(methodNames) / sizeof(methodNames[0])); i++) {
+        if (!strcmp(name, methodNames[i])) {
+            *method = (SolverMethod)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *getSolverMethodName(SolverMethod method) {
+    return methodNames[method];
+}
+
+// find the value references of the states and their derivatives. The order of the
+// derivatives in the ModelStructure defines the order of the continuous states.
+// Return 1 if the FMU provides directional derivatives for them, 0 otherwise.
+static int initDirectionalDerivative(Solver *s) {
+    int i, index;
+    ValueStatus vs;
+    ModelDescription *md = s->fmu->modelDescription;
+    ModelStructure *ms = getModelStructure(md);
+    Component *me = getModelExchange(md);
+
+    if (!s->fmu->getDirectionalDerivative || !me || !ms) return 0;
+    if (!getAttributeBool((Element *)me, att_providesDirectionalDerivative, &vs)) return 0;
+    if (getDerivativesSize(ms) != s->nx) return 0;
+    for (i = 0; i < s->nx; i++) {
+        ScalarVariable *sv;
+        index = getAttributeInt(getDerivative(ms, i), att_index, &vs);
+        if (vs != valueDefined || index < 1 || index > getScalarVariableSize(md)) return 0;
+        sv = getScalarVariable(md, index - 1);
+        s->derivativeVrs[i] = getValueReference(sv);
+        index = getAttributeInt(getTypeSpec(sv), att_derivative, &vs);
+        if (vs != valueDefined || index < 1 || index > getScalarVariableSize(md)) return 0;
+        s->stateVrs[i] = getValueReference(getScalarVariable(md, index - 1));
+    }
+    return 1;
+}
+
+Solver *createSolver(SolverMethod method, FMU *fmu, fmi2Component c, int nx, double h, double tolerance) {
+    int i;
+    int ok = 1;
+    Solver *s = (Solver *)calloc(1, sizeof(Solver));
+    if (!s) return NULL;
+    s->method = method;
+    s->fmu = fmu;
+    s->c = c;
+    s->nx = nx;
+    s->h = h;
+    s->hMax = h;
+    s->rtol = tolerance;
+    // allocate at least one element, calloc(0, ...) may return NULL
+    s->nominals = (double *)calloc(nx + 1, sizeof(double));
+    s->xPre = (double *)calloc(nx + 1, sizeof(double));
+    s->x = (double *)calloc(nx + 1, sizeof(double));
+    s->k[0] = (double *)calloc(nx + 1, sizeof(double));
+    ok = s->nominals && s->xPre && s->x && s->k[0];
+    if (method == solver_rk45) {
+        for (i = 1; i < 7; i++) {
+            s->k[i] = (double *)calloc(nx + 1, sizeof(double));
+            ok = ok && s->k[i];
+        }
+        for (i = 0; i < 4; i++) {
+            s->dense[i] = (double *)calloc(nx + 1, sizeof(double));
+            ok = ok && s->dense[i];
+        }
+        s->xNew = (double *)calloc(nx + 1, sizeof(double));
+        ok = ok && s->xNew;
+    }
+    if (method == solver_bdf) {
+        for (i = 0; i < BDF_MAX_ORDER + 3; i++) {
+            s->D[i] = (double *)calloc(nx + 1, sizeof(double));
+            ok = ok && s->D[i];
+        }
+        for (i = 0; i < 7; i++) {
+            s->work[i] = (double *)calloc(nx + 1, sizeof(double));
+            ok = ok && s->work[i];
+        }
+        s->xNew = (double *)calloc(nx + 1, sizeof(double));
+        s->jac = (double *)calloc(nx * nx + 1, sizeof(double));
+        s->lu = (double *)calloc(nx * nx + 1, sizeof(double));
+        s->pivots = (int *)calloc(nx + 1, sizeof(int));
+        s->stateVrs = (fmi2ValueReference *)calloc(nx + 1, sizeof(fmi2ValueReference));
+        s->derivativeVrs = (fmi2ValueReference *)calloc(nx + 1, sizeof(fmi2ValueReference));
+        s->pattern = createJacobianPattern(fmu->modelDescription, nx);
+        ok = ok && s->xNew && s->jac && s->lu && s->pivots && s->stateVrs && s->derivativeVrs && s->pattern;
+        if (ok) s->useDirectionalDerivative = initDirectionalDerivative(s);
+    }
+    if (!ok) {
+        freeSolver(s);
+        return NULL;
+    }
+    return s;
+}
+
+void freeSolver(Solver *s) {
+    int i;
+    if (!s) return;
+    free(s->nominals);
+    free(s->xPre);
+    free(s->x);
+    for (i = 0; i < 7; i++) free(s->k[i]);
+    for (i = 0; i < 4; i++) free(s->dense[i]);
+    for (i = 0; i < BDF_MAX_ORDER + 3; i++) free(s->D[i]);
+    for (i = 0; i < 7; i++) free(s->work[i]);
+    free(s->xNew);
+    free(s->jac);
+    free(s->lu);
+    free(s->pivots);
+    free(s->stateVrs);
+    free(s->derivativeVrs);
+    freeJacobianPattern(s->pattern);
+    free(s);
+}
+
+// evaluate in dx the derivatives of the FMU at time t and states x
+static int rhs(Solver *s, double t, const double *x, double *dx) {
+    fmi2Status fmi2Flag = s->fmu->setTime(s->c, t);
+    if (fmi2Flag > fmi2Warning) return error("could not set time");
+    fmi2Flag = s->fmu->setContinuousStates(s->c, x, s->nx);
+    if (fmi2Flag > fmi2Warning) return error("could not set states");
+    fmi2Flag = s->fmu->getDerivatives(s->c, dx, s->nx);
+    if (fmi2Flag > fmi2Warning) return error("could not retrieve derivatives");
+    s->nRhs++;
+    return 1;
+}
+
+static int bdfReset(Solver *s);
+static int initialStepSize(Solver *s, int order, double *x1, double *f1, double *scale);
+
+int solverReset(Solver *s, double t) {
+    int i;
+    fmi2Status fmi2Flag;
+    s->t = t;
+    s->tPre = t;
+    fmi2Flag = s->fmu->getContinuousStates(s->c, s->x, s->nx);
+    if (fmi2Flag > fmi2Warning) return error("could not retrieve states");
+    for (i = 0; i < s->nx; i++) s->xPre[i] = s->x[i];
+    if (s->method == solver_euler) return 1;
+
+    // the nominals may have changed at an event
+    fmi2Flag = s->fmu->getNominalsOfContinuousStates(s->c, s->nominals, s->nx);
+    for (i = 0; i < s->nx; i++) {
+        if (fmi2Flag > fmi2Warning || s->nominals[i] <= 0) s->nominals[i] = 1.0;
+    }
+    fmi2Flag = s->fmu->getDerivatives(s->c, s->k[0], s->nx);
+    if (fmi2Flag > fmi2Warning) return error("could not retrieve derivatives");
+    s->nRhs++;
+    if (s->method == solver_bdf) return bdfReset(s);
+
+    // the step size before an event says nothing about the dynamics after it,
+    // e.g. the short flight of a bouncing ball, so start with a careful step
+    if (s->nx == 0) return 1;
+    if (!initialStepSize(s, 4, s->xNew, s->k[1], s->k[2])) return 0;
+    // set the FMU back to the start of the step
+    return rhs(s, s->t, s->x, s->k[0]);
+}
+
+static int eulerStep(Solver *s, double tMax) {
+    int i;
+    double dt;
+    fmi2Status fmi2Flag;
+
+    // the FMU is at (t, x): derivatives of the last step or set by the last event
+    fmi2Flag = s->fmu->getDerivatives(s->c, s->k[0], s->nx);
+    if (fmi2Flag > fmi2Warning) return error("could not retrieve derivatives");
+    s->nRhs++;
+
+    s->tPre = s->t;
+    s->t = min(s->t + s->h, tMax);
+    dt = s->t - s->tPre;
+    fmi2Flag = s->fmu->setTime(s->c, s->t);
+    if (fmi2Flag > fmi2Warning) error("could not set time");
+    for (i = 0; i < s->nx; i++) {
+        s->xPre[i] = s->x[i];
+        s->x[i] += dt * s->k[0][i];
+    }
+    fmi2Flag = s->fmu->setContinuousStates(s->c, s->x, s->nx);
+    if (fmi2Flag > fmi2Warning) return error("could not set states");
+    s->nSteps++;
+    return 1;
+}
+
+// weighted root mean square of the local error err
+static double errorNorm(Solver *s, const double *err) {
+    int i;
+    double sum = 0;
+    for (i = 0; i < s->nx; i++) {
+        double xi = max(fabs(s->x[i]), fabs(s->xNew[i]));
+        double sc = s->rtol * (s->nominals[i] + xi);
+        sum += (err[i] / sc) * (err[i] / sc);
+    }
+    return s->nx > 0 ? sqrt(sum / s->nx) : 0;
+}
+
+// nothing to integrate: advance time to tMax
+static int skipStep(Solver *s, double tMax) {
+    int i;
+    fmi2Status fmi2Flag = s->fmu->setTime(s->c, tMax);
+    if (fmi2Flag > fmi2Warning) return error("could not set time");
+    for (i = 0; i < s->nx; i++) s->xPre[i] = s->x[i];
+    s->tPre = s->t;
+    s->t = tMax;
+    s->nSteps++;
+    return 1;
+}
+
+static int rk45Step(Solver *s, double tMax) {
+    int i, j, l;
+    int rejected = 0;
+    double h, tNew, err, factor;
+    double *tmp;
+
+    if (s->nx == 0 || tMax - s->t <= 1e-14 * max(fabs(s->t), 1.0)) return skipStep(s, tMax);
+
+    for (;;) {
+        h = s->h;
+        tNew = s->t + h;
+        if (s->t + 1.01 * h >= tMax) {
+            // last step before tMax, hit tMax exactly
+            tNew = tMax;
+            h = tMax - s->t;
+        }
+        if (h <= 1e-14 * max(fabs(s->t), 1.0)) return error("step size too small");
+
+        // stages 2 to 7, stage 7 is evaluated at the new solution
+        for (j = 1; j < 7; j++) {
+            for (i = 0; i < s->nx; i++) {
+                double sum = 0;
+                for (l = 0; l < j; l++) sum += a_[j][l] * s->k[l][i];
+                s->xNew[i] = s->x[i] + h * sum;
+            }
+            if (!rhs(s, j < 6 ? s->t + c_[j] * h : tNew, s->xNew, s->k[j])) return 0;
+        }
+
+        // estimate the local error, reuse xPre as work array
+        for (i = 0; i < s->nx; i++) {
+            double sum = 0;
+            for (l = 0; l < 7; l++) sum += e_[l] * s->k[l][i];
+            s->xPre[i] = h * sum;
+        }
+        err = errorNorm(s, s->xPre);
+        factor = err > 0 ? SAFETY * pow(err, -0.2) : MAX_FACTOR;
+
+        if (err <= 1.0) break;
+
+        // reject the step and retry with smaller step size
+        s->nRejected++;
+        rejected = 1;
+        s->h = h * max(MIN_FACTOR, factor);
+    }
+
+    // accept the step and store the continuous extension
+    for (i = 0; i < s->nx; i++) {
+        double diff = s->xNew[i] - s->x[i];
+        double bspl = h * s->k[0][i] - diff;
+        double sum = 0;
+        for (l = 0; l < 7; l++) sum += d_[l] * s->k[l][i];
+        s->dense[0][i] = diff;
+        s->dense[1][i] = bspl;
+        s->dense[2][i] = diff - h * s->k[6][i] - bspl;
+        s->dense[3][i] = h * sum;
+    }
+    tmp = s->xPre; s->xPre = s->x; s->x = s->xNew; s->xNew = tmp;
+    tmp = s->k[0]; s->k[0] = s->k[6]; s->k[6] = tmp;
+    s->tPre = s->t;
+    s->t = tNew;
+    s->nSteps++;
+
+    // propose the next step size. Do not increase the step size directly after a
+    // rejection and keep the proposal if the step was only shortened to hit tMax.
+    factor = min(MAX_FACTOR, factor);
+    if (rejected) factor = min(1.0, factor);
+    if (h * factor < s->h || tNew < tMax) s->h = min(h * factor, s->hMax);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// BDF
+// ---------------------------------------------------------------------------
+
+// x is finite, i.e. not inf and not NaN
+static int isFinite(double x) {
+    return x - x == 0;
+}
+
+// root mean square of v[i] / scale[i]
+static double rmsNorm(int n, const double *v, const double *scale) {
+    int i;
+    double sum = 0;
+    for (i = 0; i < n; i++) sum += (v[i] / scale[i]) * (v[i] / scale[i]);
+    return n > 0 ? sqrt(sum / n) : 0;
+}
+
+// scale of the error of each state: atol + rtol * |x| with atol = rtol * nominal
+static void errorScale(Solver *s, const double *x, double *scale) {
+    int i;
+    for (i = 0; i < s->nx; i++) scale[i] = s->rtol * (s->nominals[i] + fabs(x[i]));
+}
+
+// R[i][j] = prod(M[k][j], k = 0..i) with M[0][j] = 1, M[k][0] = 0 for k > 0
+// and M[k][j] = (k - 1 - factor * j) / k otherwise
+static void computeR(int order, double factor, double R[BDF_MAX_ORDER + 1][BDF_MAX_ORDER + 1]) {
+    int i, j;
+    for (j = 0; j <= order; j++) R[0][j] = 1;
+    for (i = 1; i <= order; i++) {
+        R[i][0] = 0;
+        for (j = 1; j <= order; j++) R[i][j] = R[i - 1][j] * (i - 1 - factor * j) / i;
+    }
+}
+
+// rescale the backward differences D for the step size h * factor
+static void changeD(Solver *s, double factor) {
+    int i, j, k, n;
+    int order = s->order;
+    double R[BDF_MAX_ORDER + 1][BDF_MAX_ORDER + 1];
+    double U[BDF_MAX_ORDER + 1][BDF_MAX_ORDER + 1];
+    double RU[BDF_MAX_ORDER + 1][BDF_MAX_ORDER + 1];
+    double d[BDF_MAX_ORDER + 1];
+
+    computeR(order, factor, R);
+    computeR(order, 1.0, U);
+    for (i = 0; i <= order; i++) {
+        for (j = 0; j <= order; j++) {
+            RU[i][j] = 0;
+            for (k = 0; k <= order; k++) RU[i][j] += R[i][k] * U[k][j];
+        }
+    }
+    // D = RU^T * D
+    for (n = 0; n < s->nx; n++) {
+        for (j = 0; j <= order; j++) {
+            d[j] = 0;
+            for (i = 0; i <= order; i++) d[j] += RU[i][j] * s->D[i][n];
+        }
+        for (j = 0; j <= order; j++) s->D[j][n] = d[j];
+    }
+}
+
+// compute the Jacobian df/dx at time t and states x, the columns of one color at once
+static int computeJacobian(Solver *s, double t, const double *x) {
+    int i, j, k, color;
+    int nx = s->nx;
+    const JacobianPattern *p = s->pattern;
+    double *xj = s->xNew;   // perturbed states or seed vector
+    double *f0 = s->work[3];
+    double *f1 = s->work[5];
+    double *delta = s->work[6];
+    fmi2Status fmi2Flag;
+
+    if (s->useDirectionalDerivative) {
+        fmi2Flag = s->fmu->setTime(s->c, t);
+        if (fmi2Flag > fmi2Warning) return error("could not set time");
+        fmi2Flag = s->fmu->setContinuousStates(s->c, x, nx);
+        if (fmi2Flag > fmi2Warning) return error("could not set states");
+        for (color = 0; color < p->nColors; color++) {
+            for (j = 0; j < nx; j++) xj[j] = p->colors[j] == color ? 1 : 0;
+            fmi2Flag = s->fmu->getDirectionalDerivative(s->c, s->derivativeVrs, nx, s->stateVrs, nx, xj, f1);
+            if (fmi2Flag > fmi2Warning) break;
+            for (j = 0; j < nx; j++) {
+                if (p->colors[j] != color) continue;
+                for (k = p->colStart[j]; k < p->colStart[j + 1]; k++) {
+                    i = p->rowIndex[k];
+                    s->jac[i * nx + j] = f1[i];
+                }
+            }
+        }
+        if (color == p->nColors) {
+            s->nJacobians++;
+            return 1;
+        }
+        // use finite differences from now on
+        printf("warning: could not get directional derivatives, using finite differences\n");
+        s->useDirectionalDerivative = 0;
+    }
+
+    // forward differences
+    if (!rhs(s, t, x, f0)) return 0;
+    for (color = 0; color < p->nColors; color++) {
+        for (j = 0; j < nx; j++) {
+            xj[j] = x[j];
+            if (p->colors[j] != color) continue;
+            delta[j] = sqrt(DBL_EPSILON) * max(fabs(x[j]), s->nominals[j]);
+            xj[j] = x[j] + delta[j];
+            delta[j] = xj[j] - x[j]; // exactly representable
+        }
+        if (!rhs(s, t, xj, f1)) return 0;
+        for (j = 0; j < nx; j++) {
+            if (p->colors[j] != color) continue;
+            for (k = p->colStart[j]; k < p->colStart[j + 1]; k++) {
+                i = p->rowIndex[k];
+                s->jac[i * nx + j] = (f1[i] - f0[i]) / delta[j];
+            }
+        }
+    }
+    s->nJacobians++;
+    return 1;
+}
+
+// LU decomposition with partial pivoting of the iteration matrix I - c * jac.
+// Return 0 if the matrix is singular.
+static int decompose(Solver *s, double c) {
+    int i, j, k, p;
+    int n = s->nx;
+    double *a = s->lu;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) a[i * n + j] = (i == j ? 1.0 : 0.0) - c * s->jac[i * n + j];
+    }
+    s->nLU++;
+    for (k = 0; k < n; k++) {
+        p = k;
+        for (i = k + 1; i < n; i++) {
+            if (fabs(a[i * n + k]) > fabs(a[p * n + k])) p = i;
+        }
+        s->pivots[k] = p;
+        if (a[p * n + k] == 0) return 0;
+        if (p != k) {
+            for (j = 0; j < n; j++) {
+                double tmp = a[k * n + j];
+                a[k * n + j] = a[p * n + j];
+                a[p * n + j] = tmp;
+            }
+        }
+        for (i = k + 1; i < n; i++) {
+            double m = a[i * n + k] /= a[k * n + k];
+            if (m != 0) for (j = k + 1; j < n; j++) a[i * n + j] -= m * a[k * n + j];
+        }
+    }
+    return 1;
+}
+
+// solve lu * x = b, the solution overwrites b
+static void solveLU(Solver *s, double *b) {
+    int i, j;
+    int n = s->nx;
+    const double *a = s->lu;
+
+    for (i = 0; i < n; i++) {
+        if (s->pivots[i] != i) {
+            double tmp = b[i];
+            b[i] = b[s->pivots[i]];
+            b[s->pivots[i]] = tmp;
+        }
+    }
+    for (i = 1; i < n; i++) {
+        for (j = 0; j < i; j++) b[i] -= a[i * n + j] * b[j];
+    }
+    for (i = n - 1; i >= 0; i--) {
+        for (j = i + 1; j < n; j++) b[i] -= a[i * n + j] * b[j];
+        b[i] /= a[i * n + i];
+    }
+}
+
+// solve the BDF equations at tNew with the modified Newton iteration, starting at the
+// predictor. On return xNew holds the solution and d its difference to the predictor.
+// Return 1 if the iteration converged, 0 if not and -1 on errors.
+static int solveBdfSystem(Solver *s, double tNew, double c, double tol, int *nIter) {
+    int i, k;
+    int nx = s->nx;
+    double *y = s->xNew;
+    const double *yPredict = s->work[0];
+    const double *psi = s->work[1];
+    double *d = s->work[2];
+    double *dy = s->work[3];
+    const double *scale = s->work[4];
+    double dyNorm, dyNormOld = -1, rate = -1;
+
+    for (i = 0; i < nx; i++) {
+        y[i] = yPredict[i];
+        d[i] = 0;
+    }
+    for (k = 0; k < BDF_NEWTON_MAXITER; k++) {
+        *nIter = k + 1;
+        if (!rhs(s, tNew, y, dy)) return -1;
+        for (i = 0; i < nx; i++) {
+            if (!isFinite(dy[i])) return 0;
+            dy[i] = c * dy[i] - psi[i] - d[i];
+        }
+        solveLU(s, dy);
+        dyNorm = rmsNorm(nx, dy, scale);
+        if (dyNormOld >= 0) {
+            rate = dyNorm / dyNormOld;
+            // diverges or will not converge within the remaining iterations
+            if (rate >= 1 || pow(rate, BDF_NEWTON_MAXITER - k) / (1 - rate) * dyNorm > tol) return 0;
+        }
+        for (i = 0; i < nx; i++) {
+            y[i] += dy[i];
+            d[i] += dy[i];
+        }
+        if (dyNorm == 0 || (rate >= 0 && rate / (1 - rate) * dyNorm < tol)) return 1;
+        dyNormOld = dyNorm;
+    }
+    return 0;
+}
+
+// estimate the size of the first step of a method of the given order at (t, x) with
+// derivatives k[0], see Hairer, Norsett, Wanner: Solving Ordinary Differential
+// Equations I, Section II.4. x1, f1 and scale are work arrays. Sets s->h.
+static int initialStepSize(Solver *s, int order, double *x1, double *f1, double *scale) {
+    int i;
+    int nx = s->nx;
+    double d0, d1, d2, h0, h1;
+
+    errorScale(s, s->x, scale);
+    d0 = rmsNorm(nx, s->x, scale);
+    d1 = rmsNorm(nx, s->k[0], scale);
+    h0 = (d0 < 1e-5 || d1 < 1e-5) ? 1e-6 : 0.01 * d0 / d1;
+    h0 = min(h0, s->hMax);
+    for (i = 0; i < nx; i++) x1[i] = s->x[i] + h0 * s->k[0][i];
+    if (!rhs(s, s->t + h0, x1, f1)) return 0;
+    for (i = 0; i < nx; i++) f1[i] -= s->k[0][i];
+    d2 = rmsNorm(nx, f1, scale) / h0;
+    if (d1 <= 1e-15 && d2 <= 1e-15) {
+        h1 = max(1e-6, h0 * 1e-3);
+    } else {
+        h1 = pow(0.01 / max(d1, d2), 1.0 / (order + 1));
+    }
+    s->h = min(min(100 * h0, h1), s->hMax);
+    return 1;
+}
+
+// start with order 1 and estimate the initial step size
+static int bdfReset(Solver *s) {
+    int i;
+    int nx = s->nx;
+
+    s->order = 1;
+    s->nEqualSteps = 0;
+    s->luValid = 0;
+    s->jacCurrent = 0;
+    if (nx == 0) return 1;
+    if (!initialStepSize(s, 1, s->xNew, s->work[3], s->work[4])) return 0;
+
+    for (i = 0; i < BDF_MAX_ORDER + 3; i++) memset(s->D[i], 0, nx * sizeof(double));
+    for (i = 0; i < nx; i++) {
+        s->D[0][i] = s->x[i];
+        s->D[1][i] = s->h * s->k[0][i];
+    }
+
+    // the first Jacobian, later ones are only computed when Newton fails to converge
+    if (s->nJacobians == 0) {
+        if (!computeJacobian(s, s->t, s->x)) return 0;
+        s->jacCurrent = 1;
+    }
+
+    // set the FMU back to the start of the step
+    if (!rhs(s, s->t, s->x, s->k[0])) return 0;
+    return 1;
+}
+
+static int bdfStep(Solver *s, double tMax) {
+    int i, j;
+    int nx = s->nx;
+    int order, converged, nIter = 0;
+    double h, tNew, c, err, factor, safety;
+    double factors[3];
+    double tol = max(10 * DBL_EPSILON / s->rtol, min(0.03, sqrt(s->rtol)));
+    double *yPredict = s->work[0];
+    double *psi = s->work[1];
+    double *d = s->work[2];
+    double *scale = s->work[4];
+    double *tmp;
+    fmi2Status fmi2Flag;
+
+    if (nx == 0 || tMax - s->t <= 1e-14 * max(fabs(s->t), 1.0)) return skipStep(s, tMax);
+
+    if (s->h > s->hMax) {
+        changeD(s, s->hMax / s->h);
+        s->h = s->hMax;
+        s->nEqualSteps = 0;
+        s->luValid = 0;
+    }
+    s->jacCurrent = 0;
+
+    for (;;) {
+        order = s->order;
+        if (s->t + 1.01 * s->h >= tMax) {
+            // last step before tMax, hit tMax exactly
+            changeD(s, (tMax - s->t) / s->h);
+            s->h = tMax - s->t;
+            s->nEqualSteps = 0;
+            s->luValid = 0;
+            tNew = tMax;
+        } else {
+            tNew = s->t + s->h;
+        }
+        h = s->h;
+        if (h <= 1e-14 * max(fabs(s->t), 1.0)) return error("step size too small");
+
+        // predictor and the part of the corrector equation that does not depend on the solution
+        for (i = 0; i < nx; i++) {
+            yPredict[i] = 0;
+            psi[i] = 0;
+            for (j = 0; j <= order; j++) yPredict[i] += s->D[j][i];
+            for (j = 1; j <= order; j++) psi[i] += gamma_[j] * s->D[j][i];
+            psi[i] /= gamma_[order];
+        }
+        errorScale(s, yPredict, scale);
+        c = h / gamma_[order];
+
+        // modified Newton iteration, update the Jacobian only if it does not converge
+        for (;;) {
+            converged = 0;
+            if (!s->luValid) s->luValid = decompose(s, c);
+            if (s->luValid) {
+                converged = solveBdfSystem(s, tNew, c, tol, &nIter);
+                if (converged < 0) return 0;
+            }
+            if (converged || s->jacCurrent) break;
+            if (!computeJacobian(s, tNew, yPredict)) return 0;
+            s->jacCurrent = 1;
+            s->luValid = 0;
+        }
+        if (!converged) {
+            s->nRejected++;
+            changeD(s, 0.5);
+            s->h *= 0.5;
+            s->nEqualSteps = 0;
+            s->luValid = 0;
+            continue;
+        }
+
+        // estimate the local error
+        safety = 0.9 * (2 * BDF_NEWTON_MAXITER + 1) / (2 * BDF_NEWTON_MAXITER + nIter);
+        errorScale(s, s->xNew, scale);
+        err = errorConst_[order] * rmsNorm(nx, d, scale);
+        if (err <= 1.0) break;
+
+        // reject the step and retry with smaller step size, the LU decomposition is
+        // kept since the Newton iteration converged
+        s->nRejected++;
+        factor = max(BDF_MIN_FACTOR, safety * pow(err, -1.0 / (order + 1)));
+        changeD(s, factor);
+        s->h *= factor;
+        s->nEqualSteps = 0;
+    }
+
+    // accept the step and update the differences
+    s->nEqualSteps++;
+    s->nSteps++;
+    s->tPre = s->t;
+    s->t = tNew;
+    tmp = s->xPre; s->xPre = s->x; s->x = s->xNew; s->xNew = tmp;
+    for (i = 0; i < nx; i++) {
+        s->D[order + 2][i] = d[i] - s->D[order + 1][i];
+        s->D[order + 1][i] = d[i];
+    }
+    for (j = order; j >= 0; j--) {
+        for (i = 0; i < nx; i++) s->D[j][i] += s->D[j + 1][i];
+    }
+
+    // leave the FMU at the solution
+    fmi2Flag = s->fmu->setTime(s->c, s->t);
+    if (fmi2Flag > fmi2Warning) return error("could not set time");
+    fmi2Flag = s->fmu->setContinuousStates(s->c, s->x, nx);
+    if (fmi2Flag > fmi2Warning) return error("could not set states");
+
+    // change step size and order after order + 1 steps with constant step size
+    if (s->nEqualSteps < order + 1) return 1;
+    factors[0] = 0;
+    if (order > 1) {
+        double errM = errorConst_[order - 1] * rmsNorm(nx, s->D[order], scale);
+        factors[0] = errM > 0 ? pow(errM, -1.0 / order) : BDF_MAX_FACTOR;
+    }
+    factors[1] = err > 0 ? pow(err, -1.0 / (order + 1)) : BDF_MAX_FACTOR;
+    factors[2] = 0;
+    if (order < BDF_MAX_ORDER) {
+        double errP = errorConst_[order + 1] * rmsNorm(nx, s->D[order + 2], scale);
+        factors[2] = errP > 0 ? pow(errP, -1.0 / (order + 2)) : BDF_MAX_FACTOR;
+    }
+    j = 0;
+    for (i = 1; i < 3; i++) if (factors[i] > factors[j]) j = i;
+    s->order += j - 1;
+    factor = min(BDF_MAX_FACTOR, safety * factors[j]);
+    factor = min(factor, s->hMax / s->h);
+    changeD(s, factor);
+    s->h *= factor;
+    s->nEqualSteps = 0;
+    s->luValid = 0;
+    return 1;
+}
+
+int solverStep(Solver *s, double tMax) {
+    switch (s->method) {
+        case solver_euler: return eulerStep(s, tMax);
+        case solver_rk45:  return rk45Step(s, tMax);
+        case solver_bdf:   return bdfStep(s, tMax);
+        default: return error("unknown solver method");
+    }
+}
+
+void solverInterpolate(Solver *s, double t, double *x) {
+    int i;
+    double h = s->t - s->tPre;
+    double theta = h > 0 ? (t - s->tPre) / h : 1.0;
+    double theta1 = 1.0 - theta;
+
+    switch (s->method) {
+        case solver_bdf: {
+            // interpolating polynomial of the backward differences
+            int j;
+            double p = 1;
+            for (i = 0; i < s->nx; i++) x[i] = s->D[0][i];
+            for (j = 1; j <= s->order; j++) {
+                p *= (t - (s->t - s->h * (j - 1))) / (s->h * j);
+                for (i = 0; i < s->nx; i++) x[i] += s->D[j][i] * p;
+            }
+            break;
+        }
+        case solver_rk45:
+            if (s->nx > 0 && h > 0) {
+                for (i = 0; i < s->nx; i++) {
+                    x[i] = s->xPre[i] + theta * (s->dense[0][i] + theta1 * (s->dense[1][i]
+                         + theta * (s->dense[2][i] + theta1 * s->dense[3][i])));
+                }
+                break;
+            }
+            // fall through
+        default:
+            // linear interpolation between the states at tPre and t
+            for (i = 0; i < s->nx; i++) x[i] = s->xPre[i] + theta * (s->x[i] - s->xPre[i]);
+    }
+}
+
+// indicator z changed sign from za to zb, or reached zero
+static int crossed(double za, double zb) {
+    return (za > 0 && zb <= 0) || (za < 0 && zb >= 0);
+}
+
+// set the FMU to time t and the interpolated states x(t), get the indicators z if not NULL
+static int setInterpolated(Solver *s, double t, double *x, int nz, double *z) {
+    fmi2Status fmi2Flag;
+    solverInterpolate(s, t, x);
+    fmi2Flag = s->fmu->setTime(s->c, t);
+    if (fmi2Flag > fmi2Warning) return error("could not set time");
+    fmi2Flag = s->fmu->setContinuousStates(s->c, x, s->nx);
+    if (fmi2Flag > fmi2Warning) return error("could not set states");
+    if (!z) return 1;
+    fmi2Flag = s->fmu->getEventIndicators(s->c, z, nz);
+    if (fmi2Flag > fmi2Warning) return error("could not retrieve event indicators");
+    return 1;
+}
+
+// The indicators are sampled at EVENT_SAMPLES - 1 interior points of the step to
+// find the first part of the step in which an indicator crosses zero. The crossing
+// is then located by the Illinois variant of the regula falsi on all indicators that
+// cross zero in that part, see Dahlquist, Bjoerck: Numerical Methods, Section 6.2.
+// The bracket (ta, tb] is narrowed until it is shorter than the tolerance, the result is tb.
+int solverLocateEvent(Solver *s, int nz, const double *zPre, double *z, int *found, double *tEvent) {
+    int i, j, iter;
+    int ok = 1;
+    int side = 0;           // end of the bracket replaced last: -1 left, 1 right
+    int parts = s->method == solver_euler ? 1 : EVENT_SAMPLES; // euler interpolates linearly
+    double ta = s->tPre;
+    double tb = s->t;
+    double fa = 1, fb = 1;  // weights of za and zb, halved by the Illinois modification
+    double tol = 1e-12 * max(fabs(s->t), 1.0);
+    double *za = (double *)calloc(nz + 1, sizeof(double));
+    double *zb = (double *)calloc(nz + 1, sizeof(double));
+    double *x = (double *)calloc(s->nx + 1, sizeof(double));
+
+    if (!za || !zb || !x) {
+        free(za);
+        free(zb);
+        free(x);
+        return error("out of memory");
+    }
+    for (i = 0; i < nz; i++) za[i] = zPre[i];
+    *found = 0;
+    for (j = 1; ok && j <= parts && !*found; j++) {
+        if (j < parts) {
+            tb = s->tPre + (s->t - s->tPre) * j / parts;
+            ok = setInterpolated(s, tb, x, nz, zb);
+        } else {
+            tb = s->t;
+            for (i = 0; i < nz; i++) zb[i] = z[i];
+        }
+        for (i = 0; ok && i < nz; i++) *found = *found || crossed(za[i], zb[i]);
+        if (ok && !*found) {
+            ta = tb;
+            for (i = 0; i < nz; i++) za[i] = zb[i];
+        }
+    }
+    if (!ok || !*found) {
+        // no event, set the FMU back to the end of the step
+        if (ok && parts > 1) ok = setInterpolated(s, s->t, x, nz, NULL);
+        *tEvent = s->t;
+        free(za);
+        free(zb);
+        free(x);
+        return ok;
+    }
+
+    for (iter = 0; iter < 100 && tb - ta > tol; iter++) {
+        int left = 0;
+        double tm = tb;
+        for (i = 0; i < nz; i++) {
+            if (crossed(za[i], zb[i])) {
+                double ti = tb - (tb - ta) * fb * zb[i] / (fb * zb[i] - fa * za[i]);
+                if (ti < tm) tm = ti;
+            }
+        }
+        if (!(tm > ta && tm < tb)) tm = 0.5 * (ta + tb);
+
+        ok = setInterpolated(s, tm, x, nz, z);
+        if (!ok) break;
+        for (i = 0; i < nz; i++) left = left || crossed(za[i], z[i]);
+        if (left) {
+            // crossing in (ta, tm]
+            tb = tm;
+            for (i = 0; i < nz; i++) zb[i] = z[i];
+            fb = 1;
+            if (side == 1) fa *= 0.5;
+            side = 1;
+        } else {
+            // crossing in (tm, tb]
+            ta = tm;
+            for (i = 0; i < nz; i++) za[i] = z[i];
+            fa = 1;
+            if (side == -1) fb *= 0.5;
+            side = -1;
+        }
+    }
+
+    // set the FMU to the end of the bracket, after the crossing
+    if (ok) ok = setInterpolated(s, tb, x, nz, NULL);
+    for (i = 0; i < nz; i++) z[i] = zb[i];
+    *tEvent = tb;
+    free(za);
+    free(zb);
+    free(x);
+    return ok;
+}
@@ -0,0 +1,83 @@
+/* -------------------------------------------------------------------------
+ * solver.h
+ * Numerical integration methods used by fmusim_me to advance the
+ * continuous states of a FMI 2.0 Model Exchange FMU.
+ * Copyright QTronic GmbH. All rights reserved.
+ * -------------------------------------------------------------------------*/
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "fmi2.h"
+#include "jacobian.h"
+
+typedef enum {
+    solver_euler, // forward Euler, fixed step size h
+    solver_rk45,  // Dormand-Prince 4(5), adaptive step size with error control
+    solver_bdf    // implicit BDF of order 1 to 5, adaptive step size and order, for stiff models
+} SolverMethod;
+
+#define BDF_MAX_ORDER 5
+
+typedef struct {
+    SolverMethod method;
+    FMU *fmu;
+    fmi2Component c;
+    int nx;              // number of continuous states
+    double h;            // euler: fixed step size, rk45: proposed size of the next step
+    double hMax;         // maximum step size, limits the chance to step over state events
+    double rtol;         // relative tolerance of the adaptive methods
+    double *nominals;    // nominal values of the states, absolute tolerance is rtol * nominal
+    double tPre;         // start time of the last step
+    double t;            // current time, end of the last step
+    double *xPre;        // states at tPre
+    double *x;           // states at t
+    double *k[7];        // stage derivatives, k[0] holds the derivatives at (t, x)
+    double *xNew;        // work array: candidate states of a step
+    double *dense[4];    // coefficients of the continuous extension of the last step
+    // bdf
+    int order;           // order of the next step
+    int nEqualSteps;     // number of steps taken with the current step size and order
+    double *D[BDF_MAX_ORDER + 3]; // backward differences of the solution, scaled with h
+    double *work[7];     // work arrays of the Newton iteration and the Jacobian
+    double *jac;         // Jacobian df/dx at a recent point, nx * nx, row major
+    double *lu;          // LU decomposition of I - c * jac, nx * nx, row major
+    int *pivots;         // row interchanges of the LU decomposition
+    int luValid;         // 1 if lu matches jac and the current step size and order
+    int jacCurrent;      // 1 if jac was computed at the start of the current step
+    int useDirectionalDerivative; // compute jac with fmi2GetDirectionalDerivative
+    JacobianPattern *pattern;     // sparsity pattern and column coloring of jac
+    fmi2ValueReference *stateVrs;      // value references of the states
+    fmi2ValueReference *derivativeVrs; // value references of the derivatives
+    int nJacobians;      // number of Jacobian evaluations
+    int nLU;             // number of LU decompositions
+    int nSteps;          // number of accepted steps
+    int nRejected;       // number of rejected steps
+    int nRhs;            // number of derivative evaluations
+} Solver;
+
+// return 0 if name is not a known method
+int getSolverMethod(const char *name, SolverMethod *method);
+const char *getSolverMethodName(SolverMethod method);
+// h is the fixed step size for euler and the maximum step size for rk45 and bdf.
+// return NULL on errors. Caller must call freeSolver(s) if not NULL.
+Solver *createSolver(SolverMethod method, FMU *fmu, fmi2Component c, int nx, double h, double tolerance);
+void freeSolver(Solver *s);
+// (re)start integration at time t from the current states of the FMU,
+// e.g. after initialization and after each event. Return 0 on errors.
+int solverReset(Solver *s, double t);
+// perform one step, but do not pass tMax. On return s->t is the reached time
+// and the FMU is set to time s->t and states s->x. Return 0 on errors.
+int solverStep(Solver *s, double tMax);
+// compute in x the states at time t, with s->tPre <= t <= s->t
+void solverInterpolate(Solver *s, double t, double *x);
+// find and locate the first zero crossing of the nz event indicators in the last step,
+// from zPre at s->tPre to z at s->t, using the interpolated states. Also finds crossings
+// where an indicator returns to its sign of s->tPre within the step. If a crossing is
+// found, found is set to 1, tEvent is the first time found after the crossing, the FMU is
+// set to tEvent and the interpolated states and z holds the event indicators there.
+// Otherwise found is 0, tEvent is s->t and the FMU is set to s->t and the states s->x.
+// Return 0 on errors.
+int solverLocateEvent(Solver *s, int nz, const double *zPre, double *z, int *found, double *tEvent);
+
+#endif // SOLVER_H
@@ -19,6 +19,7 @@
 #define TRUE 1
 #define FALSE 0
 #define min(a,b) (a>b ? b : a)
+#define max(a,b) (a>b ? a : b)
 #define HMODULE void *
 /* See http://www.yolinux.com/TUTORIALS/LibraryArchives-StaticAndDynamic.html */
 #include <dlfcn.h>
@@ -32,6 +33,8 @@ typedef struct {
     ModelDescription* modelDescription;
 
     HMODULE dllHandle; // fmu.dll handle
+    char *directory;   // directory of the unzipped FMU, ends with a separator, NULL if nothing is unzipped
+    int cached;        // directory is in the cache and kept after the run
     /***************************************************
     Common Functions
     ****************************************************/
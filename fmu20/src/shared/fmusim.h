@@ -0,0 +1,78 @@
+/* -------------------------------------------------------------------------
+ * fmusim.h
+ * Library interface of the FMU simulators fmusim_cs and fmusim_me, to run
+ * simulations of FMI 2.0 FMUs inside another program. The library is built
+ * once per FMI type, e.g. libfmusim_20_cs for co-simulation, and never exits
+ * the process: all functions report errors with a SimStatus.
+ *
+ * A Simulation holds the loaded FMU and its instance. Several simulations may
+ * be loaded at the same time. Typical use:
+ *   Simulation *sim;
+ *   RunSettings settings = { 10, 0.1, fmi2False, ',', 0, NULL, NULL };
+ *   if (loadSimulation("a.fmu", NULL, NULL, &sim) == simOK) {
+ *       status = runSimulation(sim, &settings);  // may be repeated
+ *       freeSimulation(sim);
+ *   }
+ * Messages, e.g. of the FMU logger, are printed to stdout.
+ * Copyright QTronic GmbH. All rights reserved.
+ * -------------------------------------------------------------------------*/
+
+#ifndef FMUSIM_H
+#define FMUSIM_H
+
+#include "fmi2.h"
+#include "sim_support.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    simOK,                  // success
+    simInvalidArgument,     // an option or start value of the run is not valid
+    simLoadError,           // the FMU could not be read, unzipped, parsed or its binary loaded
+    simInstantiateError,    // the FMU could not be instantiated
+    simModelError,          // a function of the FMU failed, e.g. fmi2DoStep
+    simOutputError,         // the result file could not be written
+    simOutOfMemory
+} SimStatus;
+
+// a loaded FMU and its instance, see loadSimulation()
+typedef struct {
+    FMU fmu;                         // the loaded FMU
+    fmi2CallbackFunctions callbacks; // given to the instance, with &fmu as environment of the logger
+    fmi2Component c;                 // instance used by the runs, NULL if not instantiated yet
+    int fresh;                       // c has not run yet and needs no reset
+} Simulation;
+
+// settings of a run, see runSimulation()
+typedef struct {
+    double tEnd;                // end time, the run starts at t = 0
+    double h;                   // step size, the maximal step size of adaptive solvers
+    fmi2Boolean loggingOn;      // debug logging of the FMU, used when the run instantiates it
+    char separator;             // column separator of csv result files
+    int nCategories;            // number of log categories
+    char **categories;          // log categories given to fmi2SetDebugLogging
+    const SimOptions *options;  // NULL or options of the run, e.g. solver and start values.
+                                // cache, load, timing, serve and fork are ignored
+} RunSettings;
+
+// unzip, parse and load the FMU, see loadFMU() for cacheDir and load.
+// Caller must call freeSimulation(*sim) if successful.
+SimStatus loadSimulation(const char *fmuFileName, const char *cacheDir, const char *load, Simulation **sim);
+// instantiate the FMU ahead of the first run, e.g. before forking. Does nothing if
+// there is an instance already.
+SimStatus instantiateSimulation(Simulation *sim, fmi2Boolean loggingOn);
+// check the options of a run without running it, e.g. before loading the FMU
+SimStatus checkRunSettings(const RunSettings *settings);
+// simulate from t = 0 to settings->tEnd and write the result file. The instance of the
+// previous run is reset, the FMU is instantiated if there is no instance yet.
+SimStatus runSimulation(Simulation *sim, const RunSettings *settings);
+// free the instance and unload the FMU
+void freeSimulation(Simulation *sim);
+const char *getSimStatusName(SimStatus status);
+
+#ifdef __cplusplus
+} // closing brace for extern "C"
+#endif
+#endif // FMUSIM_H
@@ -0,0 +1,396 @@
+/*
+ * Copyright QTronic GmbH. All rights reserved.
+ */
+
+/* ---------------------------------------------------------------------------*
+ * XmlBinaryCache.cpp
+ * Write and memory-map the binary form of a parsed model description.
+ *
+ * An element is stored as its type, the number of its attributes and for
+ * each attribute its Att and the offset of its value in the strings, or
+ * NO_VALUE. The children follow their parent in a fixed order, a list as its
+ * size followed by the elements, an optional element as 0 or 1 followed by
+ * the element if 1:
+ *   fmiModelDescription
+ *   list of Unit, each followed by optional BaseUnit and list of DisplayUnit
+ *   list of SimpleType, each followed by optional type, an Enumeration
+ *       followed by the list of its Item
+ *   optional ModelExchange followed by list of File
+ *   optional CoSimulation followed by list of File
+ *   list of Category
+ *   optional DefaultExperiment
+ *   list of Tool
+ *   list of ScalarVariable, each followed by optional type and list of Tool
+ *   optional ModelStructure followed by the lists of Unknown of Outputs,
+ *       Derivatives, DiscreteStates and InitialUnknowns
+ * ---------------------------------------------------------------------------*/
+
+#include "fmu20/XmlBinaryCache.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include "fmu20/XmlElement.h"
+#include "fmu20/XmlParserException.h"
+
+#ifdef STANDALONE_XML_PARSER
+#define logThis(n, ...) printf(__VA_ARGS__); printf("\n")
+#else
+#include "GlobalIncludes.h"
+#include "logging.h"  // logThis
+#endif  // STANDALONE_XML_PARSER
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define HEADER_WORDS 4
+#define NO_VALUE 0xffffffff
+
+/* -------------------------------------------------------------------------*
+ * Writer
+ * -------------------------------------------------------------------------*/
+
+class XmlBinaryWriter {
+ public:
+    std::vector<unsigned int> words;
+    std::string strings;
+    std::map<std::string, unsigned int> offsets;  // of the values in strings
+
+    void writeCount(size_t n) {
+        words.push_back((unsigned int)n);
+    }
+    void writeElement(Element *el) {
+        words.push_back((unsigned int)el->type);
+        words.push_back((unsigned int)el->attributes.size());
+        for (AttributeList::const_iterator it = el->attributes.begin();
+                it != el->attributes.end(); ++it) {
+            words.push_back((unsigned int)it->att);
+            words.push_back(it->value ? getOffset(it->value) : NO_VALUE);
+        }
+    }
+    void writeOptional(Element *el) {
+        writeCount(el ? 1 : 0);
+        if (el) writeElement(el);
+    }
+    template <typename T> void writeList(const std::vector<T *> &list) {
+        writeCount(list.size());
+        for (typename std::vector<T *>::const_iterator it = list.begin(); it != list.end(); ++it) {
+            writeElement(*it);
+        }
+    }
+    void writeComponent(Component *c) {
+        writeOptional(c);
+        if (c) writeList(c->files);
+    }
+    void writeModelDescription(ModelDescription *md);
+
+ private:
+    unsigned int getOffset(const char *value) {
+        std::map<std::string, unsigned int>::const_iterator it = offsets.find(value);
+        if (it != offsets.end()) return it->second;
+        unsigned int offset = (unsigned int)strings.size();
+        strings.append(value, strlen(value) + 1);
+        offsets[value] = offset;
+        return offset;
+    }
+};
+
+void XmlBinaryWriter::writeModelDescription(ModelDescription *md) {
+    writeElement(md);
+    writeCount(md->unitDefinitions.size());
+    for (size_t i = 0; i < md->unitDefinitions.size(); i++) {
+        Unit *unit = md->unitDefinitions[i];
+        writeElement(unit);
+        writeOptional(unit->baseUnit);
+        writeList(unit->displayUnits);
+    }
+    writeCount(md->typeDefinitions.size());
+    for (size_t i = 0; i < md->typeDefinitions.size(); i++) {
+        SimpleType *type = md->typeDefinitions[i];
+        writeElement(type);
+        writeOptional(type->typeSpec);
+        if (type->typeSpec && type->typeSpec->type == XmlParser::elm_Enumeration) {
+            writeList(((ListElement *)type->typeSpec)->list);
+        }
+    }
+    writeComponent(md->modelExchange);
+    writeComponent(md->coSimulation);
+    writeList(md->logCategories);
+    writeOptional(md->defaultExperiment);
+    writeList(md->vendorAnnotations);
+    writeCount(md->modelVariables.size());
+    for (size_t i = 0; i < md->modelVariables.size(); i++) {
+        ScalarVariable *sv = md->modelVariables[i];
+        writeElement(sv);
+        writeOptional(sv->typeSpec);
+        writeList(sv->annotations);
+    }
+    writeOptional(md->modelStructure);
+    if (md->modelStructure) {
+        writeList(md->modelStructure->outputs);
+        writeList(md->modelStructure->derivatives);
+        writeList(md->modelStructure->discreteStates);
+        writeList(md->modelStructure->initialUnknowns);
+    }
+}
+
+bool XmlBinaryCache::write(ModelDescription *md, const char *cachePath) {
+    XmlBinaryWriter writer;
+    unsigned int header[HEADER_WORDS];
+    std::string tmpPath(cachePath);
+    char suffix[32];
+    FILE *file;
+    bool ok;
+
+    try {
+        writer.writeModelDescription(md);
+    } catch (std::bad_alloc &) {
+        logThis(ERROR_WARNING, "Out of memory writing %s", cachePath);
+        return false;
+    }
+    header[0] = MAGIC;
+    header[1] = FORMAT_VERSION;
+    header[2] = (unsigned int)writer.words.size();
+    header[3] = (unsigned int)writer.strings.size();
+
+    // concurrent writers each use their own temporary file, the last rename wins
+#if defined(_WIN32)
+    sprintf(suffix, ".%lu.tmp", (unsigned long)GetCurrentProcessId());
+#else
+    sprintf(suffix, ".%lu.tmp", (unsigned long)getpid());
+#endif
+    tmpPath += suffix;
+    file = fopen(tmpPath.c_str(), "wb");
+    if (!file) return false;
+    ok = fwrite(header, sizeof(unsigned int), HEADER_WORDS, file) == HEADER_WORDS
+        && fwrite(&writer.words[0], sizeof(unsigned int), writer.words.size(), file) == writer.words.size()
+        && fwrite(writer.strings.data(), 1, writer.strings.size(), file) == writer.strings.size();
+    ok = (fclose(file) == 0) && ok;
+#if defined(_WIN32)
+    ok = ok && MoveFileEx(tmpPath.c_str(), cachePath, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmpPath.c_str(), cachePath) == 0;
+#endif
+    if (!ok) remove(tmpPath.c_str());
+    return ok;
+}
+
+/* -------------------------------------------------------------------------*
+ * Reader
+ * -------------------------------------------------------------------------*/
+
+class XmlBinaryReader {
+ public:
+    const unsigned int *words;
+    size_t nWords;
+    size_t pos;
+    char *strings;
+    size_t stringsSize;
+    ElementArena *arena;  // of the model description being read
+
+    // throw XmlParserException if the file ends here
+    unsigned int readWord() {
+        if (pos >= nWords) throw XmlParserException("Unexpected end of records");
+        return words[pos++];
+    }
+    // a count of elements, each takes at least two words
+    size_t readCount() {
+        unsigned int n = readWord();
+        if (n > (nWords - pos) / 2) throw XmlParserException("Invalid number of elements %u", n);
+        return n;
+    }
+    void readElement(Element *el) {
+        unsigned int type = readWord();
+        size_t n = readCount();
+        if (type >= (unsigned int)XmlParser::SIZEOF_ELM) throw XmlParserException("Invalid element %u", type);
+        el->type = (XmlParser::Elm)type;
+        el->attributes.reserve(n, arena);
+        for (size_t i = 0; i < n; i++) {
+            unsigned int att = readWord();
+            unsigned int offset = readWord();
+            if (att >= (unsigned int)XmlParser::SIZEOF_ATT) throw XmlParserException("Invalid attribute %u", att);
+            if (offset != NO_VALUE && offset >= stringsSize) throw XmlParserException("Invalid value %u", offset);
+            el->attributes.insert((XmlParser::Att)att, offset == NO_VALUE ? NULL : strings + offset, arena);
+        }
+    }
+    bool readPresent() {
+        unsigned int present = readWord();
+        if (present > 1) throw XmlParserException("Invalid flag %u", present);
+        return present == 1;
+    }
+    // the element is owned by the caller when readElement is called, so nothing leaks on errors
+    template <typename T> void readList(std::vector<T *> &list) {
+        size_t n = readCount();
+        list.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            T *el = new (arena) T;
+            list.push_back(el);
+            readElement(el);
+        }
+    }
+    // c is set before the component is read, like the elements of readList
+    void readComponent(Component *&c) {
+        if (!readPresent()) return;
+        c = new (arena) Component;
+        readElement(c);
+        readList(c->files);
+    }
+    void readModelDescription(ModelDescription *md);
+};
+
+void XmlBinaryReader::readModelDescription(ModelDescription *md) {
+    size_t n;
+    readElement(md);
+    n = readCount();
+    md->unitDefinitions.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        Unit *unit = new (arena) Unit;
+        md->unitDefinitions.push_back(unit);
+        readElement(unit);
+        if (readPresent()) {
+            unit->baseUnit = new (arena) Element;
+            readElement(unit->baseUnit);
+        }
+        readList(unit->displayUnits);
+    }
+    n = readCount();
+    md->typeDefinitions.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        SimpleType *type = new (arena) SimpleType;
+        md->typeDefinitions.push_back(type);
+        readElement(type);
+        if (readPresent()) {
+            // the type decides the class, peek at it
+            if (pos < nWords && words[pos] == (unsigned int)XmlParser::elm_Enumeration) {
+                ListElement *enumeration = new (arena) ListElement;
+                type->typeSpec = enumeration;
+                readElement(enumeration);
+                readList(enumeration->list);
+            } else {
+                type->typeSpec = new (arena) Element;
+                readElement(type->typeSpec);
+            }
+        }
+    }
+    readComponent(md->modelExchange);
+    readComponent(md->coSimulation);
+    readList(md->logCategories);
+    if (readPresent()) {
+        md->defaultExperiment = new (arena) Element;
+        readElement(md->defaultExperiment);
+    }
+    readList(md->vendorAnnotations);
+    n = readCount();
+    md->modelVariables.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        ScalarVariable *sv = new (arena) ScalarVariable;
+        md->modelVariables.push_back(sv);
+        readElement(sv);
+        if (readPresent()) {
+            sv->typeSpec = new (arena) Element;
+            readElement(sv->typeSpec);
+        }
+        readList(sv->annotations);
+    }
+    if (readPresent()) {
+        md->modelStructure = new (arena) ModelStructure;
+        readElement(md->modelStructure);
+        readList(md->modelStructure->outputs);
+        readList(md->modelStructure->derivatives);
+        readList(md->modelStructure->discreteStates);
+        readList(md->modelStructure->initialUnknowns);
+    }
+    if (pos != nWords) throw XmlParserException("Unexpected records after the model description");
+}
+
+// return NULL if the file does not exist or cannot be mapped
+static void *mapFile(const char *path, size_t *size) {
+#if defined(_WIN32)
+    HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER fileSize;
+    HANDLE mapping;
+    void *data = NULL;
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        mapping = CreateFileMapping(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (mapping) {
+            // copy-on-write: the strings are handed out as char *, but never written
+            data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(mapping);  // the view keeps the mapping
+        }
+        *size = (size_t)fileSize.QuadPart;
+    }
+    CloseHandle(file);
+    return data;
+#else
+    struct stat status;
+    void *data = NULL;
+    int file = open(path, O_RDONLY);
+    if (file == -1) return NULL;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        // copy-on-write: the strings are handed out as char *, but never written
+        data = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) data = NULL;
+        *size = (size_t)status.st_size;
+    }
+    close(file);  // the mapping keeps the file
+    return data;
+#endif
+}
+
+void XmlBinaryCache::unmap(void *data, size_t size) {
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+ModelDescription *XmlBinaryCache::load(const char *cachePath) {
+    size_t size = 0;
+    void *data = mapFile(cachePath, &size);
+    const unsigned int *header = (const unsigned int *)data;
+    ModelDescription *md = NULL;
+    XmlBinaryReader reader;
+
+    if (!data) return NULL;
+    if (size < HEADER_WORDS * sizeof(unsigned int) || header[0] != MAGIC || header[1] != FORMAT_VERSION
+        || (size - HEADER_WORDS * sizeof(unsigned int)) / sizeof(unsigned int) < header[2]
+        || size != (HEADER_WORDS + (size_t)header[2]) * sizeof(unsigned int) + header[3]
+        || header[3] == 0 || ((char *)data)[size - 1] != '\0') {
+        // another format or a corrupt file, the caller parses the xml again
+        unmap(data, size);
+        return NULL;
+    }
+    reader.words = header + HEADER_WORDS;
+    reader.nWords = header[2];
+    reader.pos = 0;
+    reader.strings = (char *)data + (HEADER_WORDS + header[2]) * sizeof(unsigned int);
+    reader.stringsSize = header[3];
+    try {
+        md = new ModelDescription;
+        md->cacheData = data;
+        md->cacheSize = size;
+        reader.arena = &md->arena;
+        reader.readModelDescription(md);
+    } catch (XmlParserException &e) {
+        logThis(ERROR_WARNING, "Ignoring invalid cache file %s: %s", cachePath, e.what());
+        if (md) delete md;  // unmaps data
+        else unmap(data, size);
+        md = NULL;
+    } catch (std::bad_alloc &) {
+        logThis(ERROR_FATAL, "Out of memory");
+        if (md) delete md;
+        else unmap(data, size);
+        md = NULL;
+    }
+    return md;
+}
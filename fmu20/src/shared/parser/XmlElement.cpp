@@ -13,10 +13,14 @@
 
 #include "fmu20/XmlElement.h"
 #include <assert.h>
+#include <algorithm>
 #include <map>
+#include <new>
 #include <string>
 #include <vector>
+#include <stdlib.h>
 #include <string.h> // strcmp
+#include "fmu20/XmlBinaryCache.h"
 #include "fmu20/XmlParserException.h"
 
 #ifdef STANDALONE_XML_PARSER
@@ -26,11 +30,89 @@
 #include "logging.h"  // logThis
 #endif  // STANDALONE_XML_PARSER
 
-Element::~Element() {
-    for (std::map<XmlParser::Att, char *>::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
-        free(it->second);
+// size of the blocks of an ElementArena, larger allocations get a block of their own
+static const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+// alignment of the elements in an ElementArena, enough for pointers and doubles
+static const size_t ARENA_ALIGNMENT = 8;
+
+ElementArena::ElementArena() {
+    next = NULL;
+    left = 0;
+}
+ElementArena::~ElementArena() {
+    for (std::vector<char *>::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
+        free(*it);
+    }
+}
+char *ElementArena::allocateBytes(size_t size) {
+    if (size > left) {
+        blocks.reserve(blocks.size() + 1);  // nothing leaks if this throws
+        if (size > ARENA_BLOCK_SIZE / 4) {
+            // keep the free memory of the current block for the next allocations
+            char *block = (char *)malloc(size);
+            if (!block) throw std::bad_alloc();
+            blocks.insert(blocks.end() - (blocks.empty() ? 0 : 1), block);
+            return block;
+        }
+        next = (char *)malloc(ARENA_BLOCK_SIZE);
+        if (!next) {
+            left = 0;
+            throw std::bad_alloc();
+        }
+        blocks.push_back(next);
+        left = ARENA_BLOCK_SIZE;
+    }
+    char *result = next;
+    next += size;
+    left -= size;
+    return result;
+}
+void *ElementArena::allocate(size_t size) {
+    size_t padding = (ARENA_ALIGNMENT - (size_t)next % ARENA_ALIGNMENT) % ARENA_ALIGNMENT;
+    if (padding > left) padding = left;
+    next += padding;
+    left -= padding;
+    // malloc aligns new blocks
+    return allocateBytes((size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT);
+}
+char *ElementArena::copyString(const char *s) {
+    size_t size = strlen(s) + 1;
+    return (char *)memcpy(allocateBytes(size), s, size);
+}
+
+// order of the entries of an AttributeList, also used to search an Att
+static bool attributeLess(const AttributeList::Entry &entry, XmlParser::Att att) {
+    return entry.att < att;
+}
+void AttributeList::reserve(size_t n, ElementArena *arena) {
+    if (n <= capacity) return;
+    Entry *bigger = (Entry *)arena->allocate(n * sizeof(Entry));
+    if (this->n > 0) memcpy(bigger, entries, this->n * sizeof(Entry));
+    entries = bigger;  // the old entries are released with the arena
+    capacity = (unsigned int)n;
+}
+bool AttributeList::insert(XmlParser::Att att, char *value, ElementArena *arena) {
+    Entry *it = std::lower_bound(entries, entries + n, att, attributeLess);
+    if (it != entries + n && it->att == att) return false;
+    if (n == capacity) {
+        size_t index = it - entries;
+        reserve(capacity ? 2 * capacity : 4, arena);
+        it = entries + index;
     }
-    attributes.clear();
+    memmove(it + 1, it, (entries + n - it) * sizeof(Entry));
+    it->att = att;
+    it->value = value;
+    n++;
+    return true;
+}
+const AttributeList::Entry *AttributeList::find(XmlParser::Att att) const {
+    const_iterator it = std::lower_bound(begin(), end(), att, attributeLess);
+    if (it != end() && it->att == att) return it;
+    return NULL;
+}
+
+Element::~Element() {
+    // the attribute list and values are released with the arena
 }
 template <typename T> void Element::deleteListOfElements(const std::vector<T *> &list) {
     typename std::vector<T*>::const_iterator it;
@@ -46,8 +128,8 @@ void Element::handleElement(XmlParser *parser, const char *childName, int isEmpt
 void Element::printElement(int indent) {
     std::string indentS(indent, ' ');
     logThis(ERROR_INFO, "%s%s", indentS.c_str(), XmlParser::elmNames[type]);
-    for (std::map<XmlParser::Att, char *>::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
-        logThis(ERROR_INFO, "%s%s=%s", indentS.c_str(), XmlParser::attNames[it->first], it->second);
+    for (AttributeList::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+        logThis(ERROR_INFO, "%s%s=%s", indentS.c_str(), XmlParser::attNames[it->att], it->value);
     }
 }
 template <typename T> void Element::printListOfElements(int indent, const std::vector<T *> &list) {
@@ -58,11 +140,8 @@ template <typename T> void Element::printListOfElements(int indent, const std::v
 }
 
 const char *Element::getAttributeValue(XmlParser::Att att) {
-    std::map<XmlParser::Att, char *>::const_iterator it = attributes.find(att);
-    if (it != attributes.end()) {
-        return it->second;
-    }
-    return NULL;
+    const AttributeList::Entry *entry = attributes.find(att);
+    return entry ? entry->value : NULL;
 }
 int Element::getAttributeInt(XmlParser::Att att, XmlParser::ValueStatus *vs) {
     int n = 0;
@@ -101,7 +180,7 @@ ListElement::~ListElement() {
 void ListElement::handleElement(XmlParser *parser, const char *childName, int isEmptyElement) {
     XmlParser::Elm childType = parser->checkElement(childName);
     if (childType == XmlParser::elm_Item) {
-        Element *item = new Element;
+        Element *item = new (parser->arena) Element;
         item->type = childType;
         parser->parseElementAttributes(item);
         if (!isEmptyElement) {
@@ -132,14 +211,14 @@ Unit::~Unit() {
 void Unit::handleElement(XmlParser *parser, const char *childName, int isEmptyElement) {
     XmlParser::Elm childType = parser->checkElement(childName);
     if (childType == XmlParser::elm_BaseUnit) {
-        baseUnit = new Element;
+        baseUnit = new (parser->arena) Element;
         baseUnit->type = childType;
         parser->parseElementAttributes(baseUnit);
         if (!isEmptyElement) {
             parser->parseEndElement();
         }
     } else if (childType == XmlParser::elm_DisplayUnit) {
-        Element *displayUnit = new Element;
+        Element *displayUnit = new (parser->arena) Element;
         displayUnit->type = childType;
         parser->parseElementAttributes(displayUnit);
         displayUnits.push_back(displayUnit);
@@ -185,7 +264,7 @@ void SimpleType::handleElement(XmlParser *parser, const char *childName, int isE
         case XmlParser::elm_Integer:
         case XmlParser::elm_Boolean:
         case XmlParser::elm_String: {
-            typeSpec = new Element;
+            typeSpec = new (parser->arena) Element;
             typeSpec->type = childType;
             parser->parseElementAttributes(typeSpec);
             if (!isEmptyElement) {
@@ -194,7 +273,7 @@ void SimpleType::handleElement(XmlParser *parser, const char *childName, int isE
             break;
         }
         case XmlParser::elm_Enumeration: {
-            typeSpec = new ListElement;
+            typeSpec = new (parser->arena) ListElement;
             typeSpec->type = childType;
             parser->parseElementAttributes(typeSpec);
             if (!isEmptyElement) {
@@ -232,7 +311,7 @@ void Component::handleElement(XmlParser *parser, const char *childName, int isEm
             parser->parseChildElements(this);
         }
     } else if (childType == XmlParser::elm_File) {
-        Element *sourceFile = new Element;
+        Element *sourceFile = new (parser->arena) Element;
         sourceFile->type = childType;
         parser->parseElementAttributes(sourceFile);
         if (!isEmptyElement) {
@@ -269,7 +348,7 @@ void ScalarVariable::handleElement(XmlParser *parser, const char *childName, int
         case XmlParser::elm_Boolean:
         case XmlParser::elm_String:
         case XmlParser::elm_Enumeration: {
-            typeSpec = new Element;
+            typeSpec = new (parser->arena) Element;
             typeSpec->type = childType;
             parser->parseElementAttributes(typeSpec);
             if (!isEmptyElement) {
@@ -283,7 +362,7 @@ void ScalarVariable::handleElement(XmlParser *parser, const char *childName, int
             break;
         }
         case XmlParser::elm_Tool: {
-            Element *tool = new Element;
+            Element *tool = new (parser->arena) Element;
             tool->type = childType;
             parser->parseElementAttributes(tool, false);
             if (!isEmptyElement) {
@@ -369,7 +448,7 @@ void ModelStructure::handleElement(XmlParser *parser, const char *childName, int
         }
     case XmlParser::elm_Unknown:
         {
-            Element *unknown = new Element;
+            Element *unknown = new (parser->arena) Element;
             unknown->type = childType;
             parser->parseElementAttributes(unknown);
             if (!isEmptyElement) {
@@ -429,6 +508,8 @@ ModelDescription::ModelDescription() {
     coSimulation = NULL;
     defaultExperiment = NULL;
     modelStructure = NULL;
+    cacheData = NULL;
+    cacheSize = 0;
 }
 ModelDescription::~ModelDescription() {
     deleteListOfElements(unitDefinitions);
@@ -440,13 +521,15 @@ ModelDescription::~ModelDescription() {
     deleteListOfElements(vendorAnnotations);
     deleteListOfElements(modelVariables);
     if (modelStructure) delete modelStructure;
+    // the attribute values of all elements are in the mapped file, unmap it last
+    if (cacheData) XmlBinaryCache::unmap(cacheData, cacheSize);
 }
 void ModelDescription::handleElement(XmlParser *parser, const char *childName, int isEmptyElement) {
     XmlParser::Elm childType = parser->checkElement(childName);
     switch (childType) {
     case XmlParser::elm_CoSimulation:
         {
-            coSimulation = new Component;
+            coSimulation = new (parser->arena) Component;
             coSimulation->type = childType;
             parser->parseElementAttributes(coSimulation);
             if (!isEmptyElement) {
@@ -456,7 +539,7 @@ void ModelDescription::handleElement(XmlParser *parser, const char *childName, i
         }
     case XmlParser::elm_ModelExchange:
         {
-            modelExchange = new Component;
+            modelExchange = new (parser->arena) Component;
             modelExchange->type = childType;
             parser->parseElementAttributes(modelExchange);
             if (!isEmptyElement) {
@@ -472,7 +555,7 @@ void ModelDescription::handleElement(XmlParser *parser, const char *childName, i
         }
     case XmlParser::elm_Unit:
         {
-            Unit *unit = new Unit;
+            Unit *unit = new (parser->arena) Unit;
             unit->type = childType;
             parser->parseElementAttributes(unit);
             if (!isEmptyElement) {
@@ -489,7 +572,7 @@ void ModelDescription::handleElement(XmlParser *parser, const char *childName, i
         }
     case XmlParser::elm_SimpleType:
         {
-            SimpleType *type = new SimpleType;
+            SimpleType *type = new (parser->arena) SimpleType;
             type->type = childType;
             parser->parseElementAttributes(type);
             if (!isEmptyElement) {
@@ -500,7 +583,7 @@ void ModelDescription::handleElement(XmlParser *parser, const char *childName, i
         }
     case XmlParser::elm_DefaultExperiment:
         {
-            defaultExperiment = new Element;
+            defaultExperiment = new (parser->arena) Element;
             defaultExperiment->type = childType;
             parser->parseElementAttributes(defaultExperiment);
             if (!isEmptyElement) {
@@ -516,7 +599,7 @@ void ModelDescription::handleElement(XmlParser *parser, const char *childName, i
         }
     case XmlParser::elm_Category:
         {
-            Element *category = new Element;
+            Element *category = new (parser->arena) Element;
             category->type = childType;
             parser->parseElementAttributes(category);
             if (!isEmptyElement) {
@@ -533,7 +616,7 @@ void ModelDescription::handleElement(XmlParser *parser, const char *childName, i
         }
     case XmlParser::elm_Tool:
         {
-            Element *tool = new Element;
+            Element *tool = new (parser->arena) Element;
             tool->type = childType;
             parser->parseElementAttributes(tool, false);
             if (!isEmptyElement) {
@@ -550,7 +633,7 @@ void ModelDescription::handleElement(XmlParser *parser, const char *childName, i
         }
     case XmlParser::elm_ScalarVariable:
         {
-            ScalarVariable *variable = new ScalarVariable;
+            ScalarVariable *variable = new (parser->arena) ScalarVariable;
             variable->type = childType;
             parser->parseElementAttributes(variable);
             if (!isEmptyElement) {
@@ -561,7 +644,7 @@ void ModelDescription::handleElement(XmlParser *parser, const char *childName, i
         }
     case XmlParser::elm_ModelStructure:
         {
-            modelStructure = new ModelStructure;
+            modelStructure = new (parser->arena) ModelStructure;
             modelStructure->type = childType;
             parser->parseElementAttributes(modelStructure);
             if (!isEmptyElement) {
@@ -601,44 +684,109 @@ void ModelDescription::printElement(int indent) {
     if (modelStructure) modelStructure->printElement(childIndent);
 }
 
-SimpleType *ModelDescription::getSimpleType(const char *name) {
-    for (std::vector<SimpleType *>::const_iterator it = typeDefinitions.begin(); it != typeDefinitions.end(); ++it) {
-        const char *typeName = (*it)->getAttributeValue(XmlParser::att_name);
-        if (typeName && 0 == strcmp(typeName, name)) {
-            return (*it);
-        }
+static unsigned int hashName(const char *name) {
+    unsigned int h = 2166136261u;  // FNV-1a
+    for (; *name; name++) h = (h ^ (unsigned char)*name) * 16777619u;
+    return h;
+}
+
+template <typename T> void ElementIndex<T>::build(const std::vector<T *> &list) {
+    size_t size = 1;
+    while (size < 2 * list.size()) size *= 2;
+    slots.assign(size, Slot());
+    for (size_t i = 0; i < list.size(); i++) {
+        const char *name = list[i]->getAttributeValue(XmlParser::att_name);
+        if (!name) continue;
+        unsigned int h = hashName(name);
+        size_t k = h & (size - 1);
+        while (slots[k].element) {
+            // keep the first of elements with the same name
+            const char *other = list[slots[k].element - 1]->getAttributeValue(XmlParser::att_name);
+            if (slots[k].hash == h && !strcmp(name, other)) break;
+            k = (k + 1) & (size - 1);
+        }
+        if (slots[k].element) continue;
+        slots[k].hash = h;
+        slots[k].element = (unsigned int)i + 1;
+    }
+}
+template <typename T> T *ElementIndex<T>::find(const std::vector<T *> &list, const char *name) const {
+    unsigned int h = hashName(name);
+    size_t k = h & (slots.size() - 1);
+    while (slots[k].element) {
+        T *el = list[slots[k].element - 1];
+        if (slots[k].hash == h && !strcmp(name, el->getAttributeValue(XmlParser::att_name))) return el;
+        k = (k + 1) & (slots.size() - 1);
     }
     return NULL;
 }
 
+SimpleType *ModelDescription::getSimpleType(const char *name) {
+    if (!name) return NULL;
+    if (!typeNames.isBuilt()) typeNames.build(typeDefinitions);
+    return typeNames.find(typeDefinitions, name);
+}
+
 ScalarVariable *ModelDescription::getVariable(const char *name) {
     if (!name) return NULL;
-    for (std::vector<ScalarVariable *>::const_iterator it = modelVariables.begin(); it != modelVariables.end(); ++it) {
-        const char *varName = (*it)->getAttributeValue(XmlParser::att_name);
-        if (varName && 0 == strcmp(name, varName)) {
-            return (*it);
-        }
-    }
-    return NULL;
+    if (!variableNames.isBuilt()) variableNames.build(modelVariables);
+    return variableNames.find(modelVariables, name);
 }
 
 // Enumeration and Integer have the same base type while
 // Real, String, Boolean define own base types.
-static int sameBaseType(XmlParser::Elm  t1, XmlParser::Elm  t2){
-    return t1 == t2 ||
-           t1 == XmlParser::elm_Enumeration && t2 == XmlParser::elm_Integer ||
-           t2 == XmlParser::elm_Enumeration && t1 == XmlParser::elm_Integer;
+static XmlParser::Elm baseType(XmlParser::Elm type) {
+    return type == XmlParser::elm_Enumeration ? XmlParser::elm_Integer : type;
 }
 
-ScalarVariable *ModelDescription::getVariable(fmi2ValueReference vr, XmlParser::Elm type) {
-    for (std::vector<ScalarVariable *>::const_iterator it = modelVariables.begin(); it != modelVariables.end(); ++it) {
-        if (vr == (*it)->getValueReference() && sameBaseType(type, (*it)->typeSpec->type)) {
-            return (*it);
-        }
+size_t VariableIndex::hash(fmi2ValueReference vr, XmlParser::Elm baseType) {
+    // consecutive value references of one type get consecutive keys, the multiplication
+    // by an odd number spreads them without collisions
+    unsigned int key = vr * 4 + (unsigned int)(baseType - XmlParser::elm_Real);
+    return (key ^ (key >> 16)) * 2654435761u;
+}
+void VariableIndex::build(const std::vector<ScalarVariable *> &variables) {
+    size_t size = 1;
+    while (size < 2 * variables.size()) size *= 2;
+    slots.assign(size, Slot());
+    for (size_t i = 0; i < variables.size(); i++) {
+        ScalarVariable *sv = variables[i];
+        // same as getAttributeUInt, but strtoul is much faster than sscanf
+        const char *value = sv->getAttributeValue(XmlParser::att_valueReference);
+        char *end;
+        if (!value || !sv->typeSpec) continue;
+        fmi2ValueReference vr = (fmi2ValueReference)strtoul(value, &end, 10);
+        if (end == value) continue;
+        XmlParser::Elm type = baseType(sv->typeSpec->type);
+        size_t k = hash(vr, type) & (size - 1);
+        while (slots[k].variable) {
+            // keep the first of aliases
+            if (slots[k].vr == vr && baseType(variables[slots[k].variable - 1]->typeSpec->type) == type) break;
+            k = (k + 1) & (size - 1);
+        }
+        if (slots[k].variable) continue;
+        slots[k].vr = vr;
+        slots[k].variable = (unsigned int)i + 1;
+    }
+}
+ScalarVariable *VariableIndex::find(const std::vector<ScalarVariable *> &variables, fmi2ValueReference vr,
+                                    XmlParser::Elm type) const {
+    type = baseType(type);
+    size_t k = hash(vr, type) & (slots.size() - 1);
+    while (slots[k].variable) {
+        ScalarVariable *sv = variables[slots[k].variable - 1];
+        if (slots[k].vr == vr && baseType(sv->typeSpec->type) == type) return sv;
+        k = (k + 1) & (slots.size() - 1);
     }
     return NULL;
 }
 
+ScalarVariable *ModelDescription::getVariable(fmi2ValueReference vr, XmlParser::Elm type) {
+    // index on first use, the runs without lookups, e.g. without logging, need no index
+    if (!variableIndex.isBuilt()) variableIndex.build(modelVariables);
+    return variableIndex.find(modelVariables, vr, type);
+}
+
 const char *ModelDescription::getDescriptionForVariable(ScalarVariable *sv) {
     const char *desc = sv->getAttributeValue(XmlParser::att_description);
     // found description
@@ -666,11 +814,6 @@ const char *ModelDescription::getAttributeFromTypeOrDeclaredType(ScalarVariable
 
 Unit *ModelDescription::getUnit(const char *name) {
     if (!name) return NULL;
-    for (std::vector<Unit *>::const_iterator it = unitDefinitions.begin(); it != unitDefinitions.end(); ++it) {
-        const char *unitName = (*it)->getAttributeValue(XmlParser::att_name);
-        if (unitName && 0 == strcmp(name, unitName)) {
-            return (*it);
-        }
-    }
-    return NULL;
+    if (!unitNames.isBuilt()) unitNames.build(unitDefinitions);
+    return unitNames.find(unitDefinitions, name);
 }
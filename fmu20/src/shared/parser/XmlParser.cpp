@@ -72,7 +72,18 @@ const char *XmlParser::enuNames[SIZEOF_ENU] = {
 
 XmlParser::XmlParser(char *xmlPath) {
     this->xmlPath = (char *)checkStrdup(xmlPath);
+    xmlBuffer = NULL;
+    xmlBufferSize = 0;
     xmlReader = NULL;
+    arena = NULL;
+}
+
+XmlParser::XmlParser(const char *buffer, int size, const char *name) {
+    this->xmlPath = (char *)checkStrdup(name);
+    xmlBuffer = buffer;
+    xmlBufferSize = size;
+    xmlReader = NULL;
+    arena = NULL;
 }
 
 XmlParser::~XmlParser() {
@@ -83,7 +94,11 @@ XmlParser::~XmlParser() {
 }
 
 ModelDescription *XmlParser::parse() {
-    xmlReader = xmlReaderForFile(xmlPath, NULL, 0);
+    if (xmlBuffer) {
+        xmlReader = xmlReaderForMemory(xmlBuffer, xmlBufferSize, xmlPath, NULL, 0);
+    } else {
+        xmlReader = xmlReaderForFile(xmlPath, NULL, 0);
+    }
     ModelDescription *md = NULL;
     if (xmlReader != NULL) {
         try {
@@ -94,9 +109,12 @@ ModelDescription *XmlParser::parse() {
                         elmNames[elm_fmiModelDescription],
                         xmlTextReaderConstLocalName(xmlReader));
                 }
+                // the attributes of other versions are not known, check the version first
+                checkFmiVersion();
 
                 md = new ModelDescription;
                 md->type = elm_fmiModelDescription;
+                arena = &md->arena;
                 parseElementAttributes((Element *)md);
                 parseChildElements(md);
             } else {
@@ -104,11 +122,14 @@ ModelDescription *XmlParser::parse() {
             }
         } catch (XmlParserException& e) {
             logThis(ERROR_ERROR, "%s", e.what());
+            delete md;
             md = NULL;
         } catch (std::bad_alloc& ) {
             logThis(ERROR_FATAL, "Out of memory");
+            delete md;
             md = NULL;
         }
+        arena = NULL;
         xmlFreeTextReader(xmlReader);
     } else {
         logThis(ERROR_ERROR, "Unable to open '%s'", xmlPath);
@@ -117,14 +138,31 @@ ModelDescription *XmlParser::parse() {
     return validate(md);
 }
 
+void XmlParser::checkFmiVersion() {
+    char version[32];
+    char *value = (char *)xmlTextReaderGetAttribute(xmlReader, (const xmlChar *)attNames[att_fmiVersion]);
+    if (!value) {
+        throw XmlParserException("The FMI version of the FMU could not be read: %s", xmlPath);
+    }
+    strncpy(version, value, sizeof(version) - 1);
+    version[sizeof(version) - 1] = '\0';
+    xmlFree(value);
+    if (0 != strcmp(version, FMI_XML_VERSION)) {
+        throw XmlParserException("The FMU to simulate is FMI %s standard, but expected a FMI %s standard FMU",
+            version, FMI_XML_VERSION);
+    }
+}
+
 void XmlParser::parseElementAttributes(Element *element, bool ignoreUnknownAttributes) {
+    int n = xmlTextReaderAttributeCount(xmlReader);
+    if (n > 0) element->attributes.reserve(n, arena);
     while (xmlTextReaderMoveToNextAttribute(xmlReader)) {
         xmlChar *name = xmlTextReaderName(xmlReader);
         xmlChar *value = xmlTextReaderValue(xmlReader);
         try {
             XmlParser::Att key = checkAttribute((char *)name);
-            char *theValue = value ? (char *)checkStrdup((char *)value) : NULL;
-            element->attributes.insert(std::pair<XmlParser::Att, char *>(key, theValue));
+            char *theValue = value ? arena->copyString((char *)value) : NULL;
+            element->attributes.insert(key, theValue, arena);  // keeps the first of duplicates
         } catch (XmlParserException &ex) {
             if (ignoreUnknownAttributes) {
                 xmlFree(name);
@@ -208,27 +246,74 @@ bool XmlParser::readNextInXml() {
  * Helper functions to check validity of xml.
  * -------------------------------------------------------------------------*/
 
+// Perfect hash of a table of names, e.g. attNames. The seed of the hash is searched when
+// the index is built such that no two names share a slot. A name is then looked up with
+// one hash and one strcmp instead of a strcmp with every name of the table.
+class NameIndex {
+ private:
+    const char **names;
+    unsigned int seed;
+    unsigned int mask;       // number of slots - 1, the number of slots is a power of 2
+    std::vector<int> slots;  // index in names or -1
+
+    static unsigned int hash(const char *name, unsigned int seed) {
+        unsigned int h = 2166136261u ^ seed;  // FNV-1a
+        for (; *name; name++) h = (h ^ (unsigned char)*name) * 16777619u;
+        return h ^ (h >> 16);
+    }
+    bool fill(int n) {
+        slots.assign(mask + 1, -1);
+        for (int i = 0; i < n; i++) {
+            int &slot = slots[hash(names[i], seed) & mask];
+            if (slot >= 0) return false;
+            slot = i;
+        }
+        return true;
+    }
+
+ public:
+    NameIndex(const char *names[], int n) : names(names) {
+        for (mask = 1; mask < 2 * (unsigned int)n; mask *= 2);
+        mask--;
+        // try some seeds, double the number of slots if none of them is without collisions
+        for (;;) {
+            for (seed = 0; seed < 256; seed++) {
+                if (fill(n)) return;
+            }
+            mask = 2 * mask + 1;
+        }
+    }
+    // index of name in names, -1 if not found
+    int find(const char *name) const {
+        int i = slots[hash(name, seed) & mask];
+        return (i >= 0 && !strcmp(name, names[i])) ? i : -1;
+    }
+};
+
+static const NameIndex elmIndex(XmlParser::elmNames, XmlParser::SIZEOF_ELM);
+static const NameIndex attIndex(XmlParser::attNames, XmlParser::SIZEOF_ATT);
+static const NameIndex enuIndex(XmlParser::enuNames, XmlParser::SIZEOF_ENU);
+
 // Returns the index of name in the array.
 // Throw exception if name not found (invalid).
-static int checkName(const char *name, const char *kind, const char *array[], int n) {
-    for (int i = 0; i < n; i++) {
-        if (!strcmp(name, array[i])) {
-            return i;
-        }
+static int checkName(const char *name, const char *kind, const NameIndex &index) {
+    int i = index.find(name);
+    if (i < 0) {
+        throw XmlParserException("Illegal %s %s", kind, name);
     }
-    throw XmlParserException("Illegal %s %s", kind, name);
+    return i;
 }
 
 XmlParser::Att XmlParser::checkAttribute(const char *att) {
-    return (XmlParser::Att)checkName(att, "attribute", XmlParser::attNames, XmlParser::SIZEOF_ATT);
+    return (XmlParser::Att)checkName(att, "attribute", attIndex);
 }
 
 XmlParser::Elm XmlParser::checkElement(const char *elm) {
-    return (XmlParser::Elm)checkName(elm, "element", XmlParser::elmNames, XmlParser::SIZEOF_ELM);
+    return (XmlParser::Elm)checkName(elm, "element", elmIndex);
 }
 
 XmlParser::Enu XmlParser::checkEnumValue(const char *enu) {
-    return (XmlParser::Enu)checkName(enu, "enum value", XmlParser::enuNames, XmlParser::SIZEOF_ENU);
+    return (XmlParser::Enu)checkName(enu, "enum value", enuIndex);
 }
 
 ModelDescription *XmlParser::validate(ModelDescription *md) {
@@ -11,6 +11,7 @@
 #include "XmlParserCApi.h"
 #include "fmu20/XmlParser.h"
 #include "fmu20/XmlElement.h"
+#include "fmu20/XmlBinaryCache.h"
 
 #ifdef STANDALONE_XML_PARSER
 #define logThis(n, ...) printf(__VA_ARGS__); printf("\n")
@@ -23,6 +24,16 @@ ModelDescription* parse(char* xmlPath) {
     XmlParser parser(xmlPath);
     return parser.parse();
 }
+ModelDescription* parseBuffer(const char *buffer, int size, const char *name) {
+    XmlParser parser(buffer, size, name);
+    return parser.parse();
+}
+ModelDescription* loadModelDescriptionCache(const char *cachePath) {
+    return XmlBinaryCache::load(cachePath);
+}
+int writeModelDescriptionCache(ModelDescription *md, const char *cachePath) {
+    return XmlBinaryCache::write(md, cachePath) ? 1 : 0;
+}
 void freeModelDescription(ModelDescription *md) {
     if (md) delete md;
 }
@@ -92,6 +103,10 @@ ScalarVariable *getVariable(ModelDescription *md, const char *name) {
     return md->getVariable(name);
 }
 
+ScalarVariable *getVariableByValueReference(ModelDescription *md, fmi2ValueReference vr, Elm type) {
+    return md->getVariable(vr, (XmlParser::Elm)type);
+}
+
 const char *getDescriptionForVariable(ModelDescription *md, ScalarVariable *sv) {
     return md->getDescriptionForVariable(sv);
 }
@@ -212,9 +227,9 @@ const char **getAttributesAsArray(Element *el, int *n) {
         return NULL;
     }
     int i = 0;
-    for (std::map<XmlParser::Att, char *>::iterator it = el->attributes.begin(); it != el->attributes.end(); ++it ) {
-        result[i] = (const char*)XmlParser::attNames[it->first];
-        result[i + 1] = it->second;
+    for (AttributeList::const_iterator it = el->attributes.begin(); it != el->attributes.end(); ++it ) {
+        result[i] = (const char*)XmlParser::attNames[it->att];
+        result[i + 1] = it->value;
         i = i + 2;
     }
     return result;
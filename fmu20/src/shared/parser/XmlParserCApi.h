@@ -74,11 +74,20 @@ typedef enum {
     valueIllegal
 } ValueStatus;
 
-// Returns NULL to indicate failure
-// Otherwise, return the root node md of the AST. From the result of this
+// Returns NULL to indicate failure, e.g. if the model description is not
+// for FMI 2.0. Otherwise, return the root node md of the AST. From the result of this
 // function user can access all other elements from ModelDescription.xml.
 // The receiver must call freeModelDescription(md) to release AST memory.
 ModelDescription* parse(char* xmlPath);
+// Same as parse, but for the model description in the first size bytes of
+// buffer, e.g. read from the FMU archive. name is used in messages.
+ModelDescription* parseBuffer(const char *buffer, int size, const char *name);
+// Load a model description written by writeModelDescriptionCache, the file is
+// memory-mapped. Returns NULL if the file is missing, of another format or corrupt.
+// The receiver must call freeModelDescription(md), this also unmaps the file.
+ModelDescription* loadModelDescriptionCache(const char *cachePath);
+// Write md in the binary form read by loadModelDescriptionCache. Returns 0 on errors.
+int writeModelDescriptionCache(ModelDescription *md, const char *cachePath);
 void freeModelDescription(ModelDescription *md);
 
 
@@ -116,6 +125,9 @@ ModelStructure  *getModelStructure (ModelDescription *md);
 SimpleType *getSimpleType(ModelDescription *md, const char *name);
 // get the ScalarVariable by name, if any. NULL if not found.
 ScalarVariable *getVariable(ModelDescription *md, const char *name);
+// get the ScalarVariable by value reference and type, the first if there are aliases. Enumeration
+// and Integer share the value references. NULL if not found.
+ScalarVariable *getVariableByValueReference(ModelDescription *md, fmi2ValueReference vr, Elm type);
 // get description from variable, if not present look for type definition description.
 const char *getDescriptionForVariable(ModelDescription *md, ScalarVariable *sv);
 
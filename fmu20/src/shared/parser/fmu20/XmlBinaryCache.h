@@ -0,0 +1,40 @@
+/*
+ * Copyright QTronic GmbH. All rights reserved.
+ */
+
+/* ---------------------------------------------------------------------------*
+ * XmlBinaryCache.h
+ * Binary form of a parsed model description of a FMI 2.0 model. A cache file
+ * is written once after parsing the xml and memory-mapped on later loads. The
+ * ModelDescription built from it refers to the attribute values in the mapped
+ * file, so loading needs no xml parsing and no string copies.
+ *
+ * File layout, all words are 32 bit unsigned in native byte order:
+ *   header   magic, format version, number of record words, size of strings
+ *   records  the elements in a fixed order, see XmlBinaryCache.cpp
+ *   strings  the distinct attribute values, each terminated by 0
+ * ---------------------------------------------------------------------------*/
+
+#ifndef FMU20_XML_BINARY_CACHE_H
+#define FMU20_XML_BINARY_CACHE_H
+
+#include <stddef.h>
+
+class ModelDescription;
+
+class XmlBinaryCache {
+ public:
+    static const unsigned int MAGIC = 0x43444d46;  // "FMDC" in a little endian file
+    static const unsigned int FORMAT_VERSION = 1;  // increment with every change of the layout
+
+    // return NULL if the file is missing, of another format or corrupt.
+    // Caller must free the result if not NULL, this unmaps the file.
+    static ModelDescription *load(const char *cachePath);
+    // write md to cachePath, via a temporary file that is renamed when complete.
+    // Return false on errors.
+    static bool write(ModelDescription *md, const char *cachePath);
+    // release the mapping of a file returned by load
+    static void unmap(void *data, size_t size);
+};
+
+#endif // FMU20_XML_BINARY_CACHE_H
@@ -14,16 +14,74 @@
 #ifndef FMU20_XML_ELEMENT_H
 #define FMU20_XML_ELEMENT_H
 
-#include <map>
+#include <stddef.h>
 #include <vector>
 #include "fmu20/XmlParser.h"
 
+// Memory of the elements of a ModelDescription, their attribute lists and values. It is
+// taken from large blocks, which are released at once when the arena is destroyed.
+class ElementArena {
+ private:
+    std::vector<char *> blocks;
+    char *next;   // free memory in the current block
+    size_t left;  // size of the free memory at next
+
+    char *allocateBytes(size_t size);
+    ElementArena(const ElementArena &);  // not copyable
+    ElementArena &operator=(const ElementArena &);
+
+ public:
+    ElementArena();
+    ~ElementArena();
+    // memory aligned for any element. Throw std::bad_alloc if out of memory.
+    void *allocate(size_t size);
+    // copy of s. Throw std::bad_alloc if out of memory.
+    char *copyString(const char *s);
+};
+
+
+// Attributes of an element as (XmlParser::Att, value) entries sorted by Att, in the arena
+// of the model description. An element has only a few attributes, a flat array needs no
+// allocation per attribute and is searched faster than a std::map.
+class AttributeList {
+ public:
+    struct Entry {
+        XmlParser::Att att;
+        char *value;
+    };
+    typedef const Entry *const_iterator;
+
+ private:
+    Entry *entries;
+    unsigned int n;
+    unsigned int capacity;
+
+ public:
+    AttributeList() : entries(NULL), n(0), capacity(0) {}
+    // reserve room for n attributes, e.g. before the attributes of an element are inserted
+    void reserve(size_t n, ElementArena *arena);
+    // add the attribute. Return false and keep the present value if att is present already.
+    bool insert(XmlParser::Att att, char *value, ElementArena *arena);
+    // the entry of att, NULL if not present
+    const Entry *find(XmlParser::Att att) const;
+    size_t size() const { return n; }
+    const_iterator begin() const { return entries; }
+    const_iterator end() const { return entries + n; }
+};
+
+
 class Element {
  public:
     XmlParser::Elm type;  // element type
-    std::map<XmlParser::Att, char*> attributes;  // map with key one of XmlParser::Att
+    AttributeList attributes;  // sorted by XmlParser::Att
 
  public:
+    // Elements are allocated in the arena of their model description, e.g.
+    // new (parser->arena) Element. delete runs the destructor only, the arena frees the memory.
+    static void *operator new(size_t size, ElementArena *arena) { return arena->allocate(size); }
+    static void operator delete(void *, ElementArena *) {}
+    static void operator delete(void *) {}
+
     virtual ~Element();
     virtual void handleElement(XmlParser *parser, const char *childName, int isEmptyElement);
     virtual void printElement(int indent);
@@ -110,6 +168,48 @@ class ScalarVariable : public Element {
 };
 
 
+// Index of the scalar variables of a model description by base type and value reference,
+// a hash table with open addressing. Variables with the same value reference and base type
+// are aliases, the index returns the first of them.
+class VariableIndex {
+ private:
+    struct Slot {
+        fmi2ValueReference vr;
+        unsigned int variable;  // 1 + index in the list of variables, 0 for a free slot
+    };
+    std::vector<Slot> slots;    // the size is 0 or a power of 2
+
+    static size_t hash(fmi2ValueReference vr, XmlParser::Elm baseType);
+
+ public:
+    bool isBuilt() const { return !slots.empty(); }
+    // index the variables with a value reference and a type specification
+    void build(const std::vector<ScalarVariable *> &variables);
+    // NULL if not found
+    ScalarVariable *find(const std::vector<ScalarVariable *> &variables, fmi2ValueReference vr,
+                         XmlParser::Elm type) const;
+};
+
+
+// Index of a list of elements by their attribute name, a hash table with open addressing.
+// Of elements with the same name, the index returns the first, as a search of the list.
+template <typename T> class ElementIndex {
+ private:
+    struct Slot {
+        unsigned int hash;     // of the name
+        unsigned int element;  // 1 + index in the list, 0 for a free slot
+    };
+    std::vector<Slot> slots;   // the size is 0 or a power of 2
+
+ public:
+    bool isBuilt() const { return !slots.empty(); }
+    // index the elements with a name
+    void build(const std::vector<T *> &list);
+    // NULL if not found
+    T *find(const std::vector<T *> &list, const char *name) const;
+};
+
+
 class ModelStructure : public Element {
  private:
     XmlParser::Elm unknownParentType;  // used in handleElement to know in which list next Unknown belongs.
@@ -139,17 +239,30 @@ class ModelDescription : public Element {
     std::vector<Element *> vendorAnnotations;   // list of Tools
     std::vector<ScalarVariable *> modelVariables;  // list of ScalarVariable
     ModelStructure *modelStructure;             // not NULL ModelStructure
+    void *cacheData;                            // NULL or the mapped cache file if loaded by XmlBinaryCache
+    size_t cacheSize;
+    ElementArena arena;                         // memory of all other elements and of the attribute values
+    VariableIndex variableIndex;                // of modelVariables, built by the first getVariable(vr, type)
+    ElementIndex<ScalarVariable> variableNames; // of modelVariables, built by the first getVariable(name)
+    ElementIndex<SimpleType> typeNames;         // of typeDefinitions, built by the first getSimpleType
+    ElementIndex<Unit> unitNames;               // of unitDefinitions, built by the first getUnit
 
  public:
+    // the model description owns the arena, it is allocated on the heap
+    static void *operator new(size_t size) { return ::operator new(size); }
+    static void operator delete(void *p) { ::operator delete(p); }
+
     ModelDescription();
     ~ModelDescription();
     void handleElement(XmlParser *parser, const char *childName, int isEmptyElement);
     void printElement(int indent);
+    // The lookups by name or vr index the searched list on their first call, they must not
+    // be called before the list is complete.
     // get the SimpleType definition by name, if any. NULL if not found.
     SimpleType *getSimpleType(const char *name);
     // get the ScalarVariable by name, if any. NULL if not found.
     ScalarVariable *getVariable(const char *name);
-    // get the ScalarVariable by vr and type. NULL if not found.
+    // get the ScalarVariable by vr and type, the first if there are aliases. NULL if not found.
     ScalarVariable *getVariable(fmi2ValueReference vr, XmlParser::Elm type);
     // get description from variable, if not present look for type definition description.
     const char *getDescriptionForVariable(ScalarVariable *sv);
@@ -26,7 +26,11 @@
 typedef unsigned int fmi2ValueReference;
 #endif
 
+// the value of attribute fmiVersion accepted by the parser
+#define FMI_XML_VERSION "2.0"
+
 class Element;
+class ElementArena;
 class ModelDescription;
 
 class XmlParser {
@@ -88,10 +92,14 @@ class XmlParser {
     };
 
  private:
-    char *xmlPath;
+    char *xmlPath;              // path of the file, or name of the buffer in messages
+    const char *xmlBuffer;      // NULL when parsing the file at xmlPath
+    int xmlBufferSize;
     xmlTextReaderPtr xmlReader;
 
  public:
+    ElementArena *arena;        // of the model description being parsed, see Element::operator new
+
     // return the type of this element. Int value match the index in elmNames.
     // throw XmlParserException if element is invalid.
     static XmlParser::Elm checkElement(const char* elm);
@@ -105,6 +113,9 @@ class XmlParser {
     // Obs. the destructor calls xmlCleanupParser(). This is a single call for all parsers instantiated.
     // Be carefully how you link XmlParser (i.e. multithreading, more parsers started at once).
     explicit XmlParser(char *xmlPath);
+    // parse the model description in the first size bytes of buffer, e.g. read from the
+    // FMU archive. buffer must live as long as the parser. name is used in messages.
+    XmlParser(const char *buffer, int size, const char *name);
     ~XmlParser();
     // return NULL on errors. Caller must free the result if not NULL.
     ModelDescription *parse();
@@ -120,6 +131,9 @@ class XmlParser {
  private:
     // advance reading in xml and skip comments if present.
     bool readNextInXml();
+    // throw XmlParserException if attribute fmiVersion of the current element
+    // is missing or not FMI_XML_VERSION.
+    void checkFmiVersion();
 
     // check some properties of model description (i.e. each variable has valueReference, ...)
     // if valid return the input model description, else return NULL.
@@ -0,0 +1,515 @@
+/*
+ * Copyright QTronic GmbH. All rights reserved.
+ */
+
+/* ---------------------------------------------------------------------------*
+ * zipReader.c
+ * Read the entries of a ZIP archive. The layout of the archive follows the
+ * PKWARE APPNOTE, the deflate format is specified in RFC 1951.
+ * ---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "zipReader.h"
+
+#ifdef _WIN32
+#include <direct.h>  // _mkdir()
+#define makeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>  // mkdir()
+#define makeDirectory(path) mkdir(path, 0777)
+#endif
+
+#define END_OF_CENTRAL_DIRECTORY 0x06054b50
+#define CENTRAL_DIRECTORY_HEADER 0x02014b50
+#define LOCAL_FILE_HEADER 0x04034b50
+#define MAX_DEFLATE_RATIO 1032  // deflate expands a byte to at most this many bytes
+
+// ---------------------------------------------------------------------------
+// Inflate, the decompression of deflate streams
+// ---------------------------------------------------------------------------
+
+#define MAX_CODE_BITS 15   // maximum length of a Huffman code
+#define FAST_BITS 9        // codes up to this length are decoded by table lookup
+
+typedef struct {
+    const unsigned char *in;
+    size_t inSize;
+    size_t inPos;
+    unsigned long bits;    // bit buffer, the next bit is the lowest
+    int nBits;             // number of bits in the buffer
+    unsigned char *out;
+    size_t outSize;
+    size_t outPos;
+    int failed;            // the input ended early or is invalid
+} Inflater;
+
+// canonical Huffman code
+typedef struct {
+    short counts[MAX_CODE_BITS + 1];  // number of codes of each length
+    short symbols[288];               // symbols ordered by their code
+    unsigned short fast[1 << FAST_BITS]; // symbol << 4 | length for the next FAST_BITS bits, 0 if longer
+} Huffman;
+
+static const short lengthBase[] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short lengthExtra[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short distanceBase[] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const short distanceExtra[] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// order of the code length code lengths in a dynamic block
+static const unsigned char codeLengthOrder[] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// fill the bit buffer with at least n bits if the input has them. Return 0 if not.
+static int needBits(Inflater *s, int n) {
+    while (s->nBits < n) {
+        if (s->inPos == s->inSize) return 0;
+        s->bits |= (unsigned long)s->in[s->inPos++] << s->nBits;
+        s->nBits += 8;
+    }
+    return 1;
+}
+
+static int getBits(Inflater *s, int n) {
+    int value;
+    if (!needBits(s, n)) {
+        s->failed = 1;
+        return 0;
+    }
+    value = (int)(s->bits & ((1UL << n) - 1));
+    s->bits >>= n;
+    s->nBits -= n;
+    return value;
+}
+
+// build the code from the code lengths of n symbols. Incomplete codes are accepted,
+// their unused codes fail when decoded. Return 0 if the lengths are invalid.
+static int buildHuffman(Huffman *h, const unsigned char *lengths, int n) {
+    short offsets[MAX_CODE_BITS + 2];
+    int symbol, length, left = 1;
+    int code = 0;
+
+    memset(h->counts, 0, sizeof(h->counts));
+    memset(h->fast, 0, sizeof(h->fast));
+    for (symbol = 0; symbol < n; symbol++) h->counts[lengths[symbol]]++;
+    h->counts[0] = 0;
+    for (length = 1; length <= MAX_CODE_BITS; length++) {
+        left = (left << 1) - h->counts[length];
+        if (left < 0) return 0; // over-subscribed
+    }
+    offsets[1] = 0;
+    for (length = 1; length <= MAX_CODE_BITS; length++) offsets[length + 1] = offsets[length] + h->counts[length];
+    for (symbol = 0; symbol < n; symbol++) {
+        if (lengths[symbol]) h->symbols[offsets[lengths[symbol]]++] = (short)symbol;
+    }
+
+    // lookup table of the short codes. Codes are stored most significant bit first,
+    // so the table is indexed with the reversed code.
+    for (length = 1; length <= FAST_BITS; length++) {
+        int i;
+        int first = offsets[length] - h->counts[length];
+        for (i = 0; i < h->counts[length]; i++, code++) {
+            int k, reversed = 0;
+            for (k = 0; k < length; k++) reversed |= ((code >> k) & 1) << (length - 1 - k);
+            for (k = reversed; k < (1 << FAST_BITS); k += 1 << length) {
+                h->fast[k] = (unsigned short)(h->symbols[first + i] << 4 | length);
+            }
+        }
+        code <<= 1;
+    }
+    return 1;
+}
+
+// decode the next symbol. Return -1 on errors.
+static int decodeSymbol(Inflater *s, const Huffman *h) {
+    int code = 0, first = 0, index = 0;
+    int length;
+    if (needBits(s, FAST_BITS) || s->nBits > 0) {
+        unsigned short entry = h->fast[s->bits & ((1 << FAST_BITS) - 1)];
+        if (entry && (entry & 15) <= s->nBits) {
+            s->bits >>= entry & 15;
+            s->nBits -= entry & 15;
+            return entry >> 4;
+        }
+    }
+    // long code, or near the end of the input: decode bit by bit
+    for (length = 1; length <= MAX_CODE_BITS; length++) {
+        int count = h->counts[length];
+        code |= getBits(s, 1);
+        if (s->failed) return -1;
+        if (code - count < first) return h->symbols[index + (code - first)];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static int inflateStored(Inflater *s) {
+    size_t n;
+    // skip to the byte boundary and give back the whole bytes of the bit buffer
+    s->nBits -= s->nBits & 7;
+    s->inPos -= s->nBits / 8;
+    s->bits = 0;
+    s->nBits = 0;
+    if (s->inSize - s->inPos < 4) return 0;
+    n = s->in[s->inPos] | s->in[s->inPos + 1] << 8;
+    if ((n ^ 0xffff) != (size_t)(s->in[s->inPos + 2] | s->in[s->inPos + 3] << 8)) return 0;
+    s->inPos += 4;
+    if (s->inSize - s->inPos < n || s->outSize - s->outPos < n) return 0;
+    memcpy(s->out + s->outPos, s->in + s->inPos, n);
+    s->inPos += n;
+    s->outPos += n;
+    return 1;
+}
+
+static int inflateCodes(Inflater *s, const Huffman *literals, const Huffman *distances) {
+    for (;;) {
+        int symbol = decodeSymbol(s, literals);
+        if (symbol < 0) return 0;
+        if (symbol < 256) {
+            if (s->outPos == s->outSize) return 0;
+            s->out[s->outPos++] = (unsigned char)symbol;
+        } else if (symbol == 256) {
+            return 1;
+        } else {
+            size_t length, distance;
+            symbol -= 257;
+            if (symbol >= 29) return 0;
+            length = lengthBase[symbol] + getBits(s, lengthExtra[symbol]);
+            symbol = decodeSymbol(s, distances);
+            if (symbol < 0 || symbol >= 30) return 0;
+            distance = distanceBase[symbol] + getBits(s, distanceExtra[symbol]);
+            if (s->failed || distance > s->outPos || length > s->outSize - s->outPos) return 0;
+            // the copy may overlap its source
+            for (; length > 0; length--, s->outPos++) s->out[s->outPos] = s->out[s->outPos - distance];
+        }
+    }
+}
+
+static int inflateFixed(Inflater *s) {
+    Huffman literals, distances;
+    unsigned char lengths[288];
+    int i;
+    for (i = 0; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    buildHuffman(&literals, lengths, 288);
+    for (i = 0; i < 30; i++) lengths[i] = 5;
+    buildHuffman(&distances, lengths, 30);
+    return inflateCodes(s, &literals, &distances);
+}
+
+static int inflateDynamic(Inflater *s) {
+    Huffman literals, distances;
+    unsigned char lengths[288 + 32];
+    int nLiterals = getBits(s, 5) + 257;
+    int nDistances = getBits(s, 5) + 1;
+    int nCodes = getBits(s, 4) + 4;
+    int i = 0;
+
+    if (s->failed || nLiterals > 286 || nDistances > 30) return 0;
+    memset(lengths, 0, sizeof(lengths));
+    for (i = 0; i < nCodes; i++) lengths[codeLengthOrder[i]] = (unsigned char)getBits(s, 3);
+    if (s->failed || !buildHuffman(&literals, lengths, 19)) return 0;
+
+    // code lengths of the literal/length and the distance codes, in one sequence
+    i = 0;
+    while (i < nLiterals + nDistances) {
+        int symbol = decodeSymbol(s, &literals);
+        int repeat;
+        unsigned char length = 0;
+        if (symbol < 0) return 0;
+        if (symbol < 16) {
+            lengths[i++] = (unsigned char)symbol;
+            continue;
+        }
+        if (symbol == 16) {
+            if (i == 0) return 0;
+            length = lengths[i - 1];
+            repeat = 3 + getBits(s, 2);
+        } else if (symbol == 17) {
+            repeat = 3 + getBits(s, 3);
+        } else {
+            repeat = 11 + getBits(s, 7);
+        }
+        if (s->failed || i + repeat > nLiterals + nDistances) return 0;
+        while (repeat--) lengths[i++] = length;
+    }
+    if (lengths[256] == 0) return 0; // no end of block code
+    if (!buildHuffman(&literals, lengths, nLiterals)
+        || !buildHuffman(&distances, lengths + nLiterals, nDistances)) {
+        return 0;
+    }
+    return inflateCodes(s, &literals, &distances);
+}
+
+// decompress the deflate stream in into out, which has exactly the size of the data.
+// Return 0 on errors.
+static int inflate(const unsigned char *in, size_t inSize, unsigned char *out, size_t outSize) {
+    Inflater s;
+    int last;
+    memset(&s, 0, sizeof(s));
+    s.in = in;
+    s.inSize = inSize;
+    s.out = out;
+    s.outSize = outSize;
+    do {
+        int ok;
+        last = getBits(&s, 1);
+        switch (getBits(&s, 2)) {
+            case 0:  ok = inflateStored(&s); break;
+            case 1:  ok = inflateFixed(&s); break;
+            case 2:  ok = inflateDynamic(&s); break;
+            default: ok = 0;
+        }
+        if (!ok || s.failed) return 0;
+    } while (!last);
+    return s.outPos == outSize;
+}
+
+// ---------------------------------------------------------------------------
+// ZIP archive
+// ---------------------------------------------------------------------------
+
+static unsigned long crcTable[256];
+
+static unsigned long computeCrc32(const unsigned char *data, size_t n) {
+    unsigned long crc = 0xffffffffUL;
+    size_t i;
+    if (!crcTable[1]) {
+        unsigned long k;
+        for (k = 0; k < 256; k++) {
+            unsigned long c = k;
+            int j;
+            for (j = 0; j < 8; j++) c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+            crcTable[k] = c;
+        }
+    }
+    for (i = 0; i < n; i++) crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffUL;
+}
+
+static unsigned int get16(const unsigned char *p) {
+    return p[0] | p[1] << 8;
+}
+
+static unsigned long get32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+static ZipArchive *zipError(ZipArchive *zip, const char *path, const char *message) {
+    printf("error: Could not read %s: %s\n", path, message);
+    closeZipArchive(zip);
+    return NULL;
+}
+
+ZipArchive *openZipArchive(const char *path) {
+    ZipArchive *zip;
+    FILE *file;
+    long size;
+    const unsigned char *end = NULL;
+    const unsigned char *p;
+    size_t offset, nameSize = 0;
+    int i;
+
+    if (!(zip = (ZipArchive *)calloc(1, sizeof(ZipArchive)))) return zipError(NULL, path, "out of memory");
+    if (!(file = fopen(path, "rb"))) return zipError(zip, path, "file not found");
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return zipError(zip, path, "file not readable");
+    }
+    zip->size = (size_t)size;
+    zip->data = (unsigned char *)malloc(zip->size > 0 ? zip->size : 1);
+    if (!zip->data || fread(zip->data, 1, zip->size, file) != zip->size) {
+        fclose(file);
+        return zipError(zip, path, zip->data ? "file not readable" : "out of memory");
+    }
+    fclose(file);
+
+    // the end of central directory record is followed by a comment of up to 64 KB
+    if (zip->size >= 22) {
+        for (p = zip->data + zip->size - 22; p >= zip->data && zip->data + zip->size - p <= 22 + 0xffff; p--) {
+            if (get32(p) == END_OF_CENTRAL_DIRECTORY) {
+                end = p;
+                break;
+            }
+        }
+    }
+    if (!end) return zipError(zip, path, "not a ZIP archive");
+    zip->nEntries = get16(end + 10);
+    offset = get32(end + 16);
+    if (get16(end + 4) != 0 || get16(end + 6) != 0 || offset == 0xffffffffUL) {
+        return zipError(zip, path, "multi-volume and ZIP64 archives are not supported");
+    }
+    if (offset > (size_t)(end - zip->data)) return zipError(zip, path, "invalid central directory");
+
+    // first pass: check the headers and sum up the lengths of the names
+    p = zip->data + offset;
+    for (i = 0; i < zip->nEntries; i++) {
+        if (end - p < 46 || get32(p) != CENTRAL_DIRECTORY_HEADER
+            || (size_t)(end - p) < 46 + get16(p + 28) + get16(p + 30) + get16(p + 32)) {
+            return zipError(zip, path, "invalid central directory");
+        }
+        nameSize += get16(p + 28) + 1;
+        p += 46 + get16(p + 28) + get16(p + 30) + get16(p + 32);
+    }
+    zip->entries = (ZipEntry *)calloc(zip->nEntries + 1, sizeof(ZipEntry));
+    zip->names = (char *)calloc(nameSize + 1, sizeof(char));
+    if (!zip->entries || !zip->names) return zipError(zip, path, "out of memory");
+
+    // second pass: collect the entries
+    p = zip->data + offset;
+    nameSize = 0;
+    for (i = 0; i < zip->nEntries; i++) {
+        ZipEntry *entry = &zip->entries[i];
+        size_t n = get16(p + 28);
+        if (get16(p + 8) & 1) return zipError(zip, path, "encrypted entries are not supported");
+        entry->method = get16(p + 10);
+        entry->crc = get32(p + 16);
+        entry->compressedSize = get32(p + 20);
+        entry->size = get32(p + 24);
+        entry->headerOffset = get32(p + 42);
+        memcpy(zip->names + nameSize, p + 46, n);
+        entry->name = zip->names + nameSize;
+        nameSize += n + 1;
+        p += 46 + n + get16(p + 30) + get16(p + 32);
+    }
+    return zip;
+}
+
+void closeZipArchive(ZipArchive *zip) {
+    if (!zip) return;
+    free(zip->data);
+    free(zip->entries);
+    free(zip->names);
+    free(zip);
+}
+
+int findZipEntry(ZipArchive *zip, const char *name) {
+    int i;
+    for (i = 0; i < zip->nEntries; i++) {
+        if (strcmp(zip->entries[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+unsigned char *readZipEntry(ZipArchive *zip, int i, size_t *size) {
+    ZipEntry *entry = &zip->entries[i];
+    const unsigned char *header = zip->data + entry->headerOffset;
+    const unsigned char *data;
+    unsigned char *out;
+    int ok;
+
+    if (entry->headerOffset > zip->size || zip->size - entry->headerOffset < 30
+        || get32(header) != LOCAL_FILE_HEADER) {
+        printf("error: Invalid ZIP entry %s\n", entry->name);
+        return NULL;
+    }
+    // the local header may have another extra field than the central directory
+    data = header + 30 + get16(header + 26) + get16(header + 28);
+    if ((size_t)(data - zip->data) > zip->size || (size_t)(zip->data + zip->size - data) < entry->compressedSize) {
+        printf("error: Invalid ZIP entry %s\n", entry->name);
+        return NULL;
+    }
+    if (entry->method != 0 && entry->method != 8) {
+        printf("error: Compression method %d of ZIP entry %s is not supported\n", entry->method, entry->name);
+        return NULL;
+    }
+    // the size is checked against the compressed data before it is allocated
+    if (entry->method == 0 ? entry->size != entry->compressedSize
+                           : entry->size / MAX_DEFLATE_RATIO > entry->compressedSize) {
+        printf("error: ZIP entry %s is corrupt\n", entry->name);
+        return NULL;
+    }
+    if (!(out = (unsigned char *)malloc(entry->size + 1))) {
+        printf("error: out of memory\n");
+        return NULL;
+    }
+    if (entry->method == 0) {
+        memcpy(out, data, entry->size);
+        ok = 1;
+    } else {
+        ok = inflate(data, entry->compressedSize, out, entry->size);
+    }
+    if (!ok || computeCrc32(out, entry->size) != entry->crc) {
+        printf("error: ZIP entry %s is corrupt\n", entry->name);
+        free(out);
+        return NULL;
+    }
+    out[entry->size] = '\0';
+    if (size) *size = entry->size;
+    return out;
+}
+
+// create the parent directories of path
+static void makeParentDirectories(char *path) {
+    char *p;
+    for (p = path + 1; *p; p++) {
+        if ((*p == '/' || *p == '\\') && p[-1] != ':') {
+            char c = *p;
+            *p = '\0';
+            makeDirectory(path); // fails if the directory exists
+            *p = c;
+        }
+    }
+}
+
+// 1 if the name would be written outside the target directory
+static int isUnsafeName(const char *name) {
+    const char *p = name;
+    if (*name == '/' || *name == '\\' || strchr(name, ':')) return 1;
+    while (*p) {
+        if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\\' || p[2] == '\0')) return 1;
+        while (*p && *p != '/' && *p != '\\') p++;
+        if (*p) p++;
+    }
+    return 0;
+}
+
+int extractZipEntry(ZipArchive *zip, int i, const char *dir) {
+    ZipEntry *entry = &zip->entries[i];
+    size_t n = strlen(entry->name);
+    char *path;
+    unsigned char *data = NULL;
+    FILE *file;
+    int ok;
+
+    if (isUnsafeName(entry->name)) {
+        printf("error: ZIP entry %s is outside of the archive\n", entry->name);
+        return 0;
+    }
+    if (!(path = (char *)calloc(strlen(dir) + n + 1, sizeof(char)))) {
+        printf("error: out of memory\n");
+        return 0;
+    }
+    sprintf(path, "%s%s", dir, entry->name);
+    makeParentDirectories(path);
+    if (n > 0 && entry->name[n - 1] == '/') {
+        // a directory, already created as parent of its trailing '/'
+        free(path);
+        return 1;
+    }
+    if (!(data = readZipEntry(zip, i, NULL))) {
+        free(path);
+        return 0;
+    }
+    ok = (file = fopen(path, "wb")) != NULL;
+    if (ok) {
+        ok = fwrite(data, 1, entry->size, file) == entry->size;
+        if (fclose(file) != 0) ok = 0;
+    }
+    if (!ok) printf("error: Could not write %s\n", path);
+    free(data);
+    free(path);
+    return ok;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright QTronic GmbH. All rights reserved.
+ */
+
+/* ---------------------------------------------------------------------------*
+ * zipReader.h
+ * Read the entries of a ZIP archive, e.g. a FMU, without external tools.
+ * Entries may be stored or compressed with deflate. ZIP64, encryption and
+ * archives spanning several files are not supported.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef zipReader_h
+#define zipReader_h
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+// entry of the central directory
+typedef struct {
+    const char *name;          // path in the archive, '/' separated
+    int method;                // 0: stored, 8: deflate
+    unsigned long crc;         // CRC-32 of the uncompressed data
+    size_t compressedSize;
+    size_t size;               // size of the uncompressed data
+    size_t headerOffset;       // position of the local header in the archive
+} ZipEntry;
+
+typedef struct {
+    unsigned char *data;       // the whole archive
+    size_t size;
+    ZipEntry *entries;
+    int nEntries;
+    char *names;               // the names of the entries, each terminated by 0
+} ZipArchive;
+
+// read the archive at path into memory and parse its central directory.
+// Return NULL on errors. Caller must call closeZipArchive(zip) if not NULL.
+ZipArchive *openZipArchive(const char *path);
+void closeZipArchive(ZipArchive *zip);
+// return the index of the entry with the given name, -1 if not found
+int findZipEntry(ZipArchive *zip, const char *name);
+// return the uncompressed data of the i-th entry, followed by a terminating 0 to ease
+// parsing of text. Return NULL on errors. Caller must free the result.
+unsigned char *readZipEntry(ZipArchive *zip, int i, size_t *size);
+// write the i-th entry to dir + name, directories are created as needed.
+// Return 0 on errors.
+int extractZipEntry(ZipArchive *zip, int i, const char *dir);
+
+#ifdef __cplusplus
+} // closing brace for extern "C"
+#endif
+#endif // zipReader_h
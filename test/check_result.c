@@ -0,0 +1,337 @@
+/* -------------------------------------------------------------------------
+ * check_result.c
+ * Checks the result files of the simulators in the tests, see CMakeLists.txt.
+ * Reads CSV files with separator ',', MAT v4 files in the layout of Dymola
+ * and raw files, see writeMatHeader() and writeRawHeader() in sim_support.c.
+ *
+ * usage: check_result size <file> <columns> <rows>
+ *        check_result times <file> <t1,t2,...>
+ *        check_result interval <file> <tStart> <tEnd> <interval>
+ *        check_result compare <file> <reference file> <tolerance>
+ *
+ * size checks the number of columns, including time, and of rows. times
+ * checks that the rows are at exactly the given times, interval that they
+ * are at the points of the output grid of --output-interval. compare
+ * checks that file has the rows of the reference and that each column of the
+ * reference is in file, with |value - reference| <= tolerance * max(1, |reference|).
+ * A tolerance of 0 requires identical values. Columns of strings are ignored.
+ * Exits with 0 if the check passes, prints the first difference otherwise.
+ * Copyright QTronic GmbH. All rights reserved.
+ * -------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef struct {
+    int nColumns;    // including time
+    int nRows;
+    char **names;    // nColumns names
+    double *values;  // nRows rows of nColumns values, NaN for strings
+} Result;
+
+static int fail(const char *message, const char *detail) {
+    printf("check_result: %s%s\n", message, detail ? detail : "");
+    return 0;
+}
+
+static void freeResult(Result *r) {
+    int k;
+    if (r->names) for (k = 0; k < r->nColumns; k++) free(r->names[k]);
+    free(r->names);
+    free(r->values);
+}
+
+// read the whole file into a buffer terminated by 0
+static unsigned char *readFile(const char *path, size_t *size) {
+    long n;
+    unsigned char *data;
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    if (fseek(file, 0, SEEK_END) != 0 || (n = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    data = (unsigned char *)malloc(n + 1);
+    if (data && fread(data, 1, n, file) != (size_t)n) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    if (!data) return NULL;
+    data[n] = '\0';
+    *size = (size_t)n;
+    return data;
+}
+
+static char *copyString(const char *s, size_t n) {
+    char *copy = (char *)malloc(n + 1);
+    if (!copy) return NULL;
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+static unsigned int get32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static double getDouble(const unsigned char *p) {
+    unsigned char bytes[8];
+    unsigned int one = 1;
+    double d;
+    int i;
+    // the files are little-endian
+    for (i = 0; i < 8; i++) bytes[i] = *(unsigned char *)&one == 1 ? p[i] : p[7 - i];
+    memcpy(&d, bytes, 8);
+    return d;
+}
+
+// a CSV file, one name per column in the header, strings are read as NaN
+static int readCsv(char *text, Result *r) {
+    char *p = text;
+    char *end;
+    int k, capacity = 0;
+
+    r->nColumns = 1;
+    for (p = text; *p && *p != '\n'; p++) if (*p == ',') r->nColumns++;
+    r->names = (char **)calloc(r->nColumns, sizeof(char *));
+    if (!r->names) return fail("out of memory", NULL);
+    p = text;
+    for (k = 0; k < r->nColumns; k++) {
+        end = p + strcspn(p, ",\r\n");
+        if (!(r->names[k] = copyString(p, end - p))) return fail("out of memory", NULL);
+        p = *end == ',' ? end + 1 : end;
+    }
+    while (*p == '\r' || *p == '\n') p++;
+    while (*p) {
+        if (r->nRows == capacity) {
+            double *values;
+            capacity = capacity > 0 ? 2 * capacity : 256;
+            values = (double *)realloc(r->values, capacity * r->nColumns * sizeof(double));
+            if (!values) return fail("out of memory", NULL);
+            r->values = values;
+        }
+        for (k = 0; k < r->nColumns; k++) {
+            double *value = &r->values[r->nRows * r->nColumns + k];
+            size_t n = strcspn(p, ",\r\n");
+            *value = strtod(p, &end);
+            if (end != p + n || n == 0) *value = NAN;
+            p += n;
+            if (k < r->nColumns - 1) {
+                if (*p != ',') return fail("row with too few columns in the CSV file", NULL);
+                p++;
+            }
+        }
+        if (*p && *p != '\r' && *p != '\n') return fail("row with too many columns in the CSV file", NULL);
+        while (*p == '\r' || *p == '\n') p++;
+        r->nRows++;
+    }
+    return 1;
+}
+
+// a MAT v4 file: name is a text matrix with one name per column, data_2 holds
+// one result row per column, dataInfo maps the names to the rows of data_2
+static int readMat(const unsigned char *data, size_t size, Result *r) {
+    size_t pos = 0;
+    const unsigned char *names = NULL;
+    const unsigned char *dataInfo = NULL;
+    const unsigned char *data2 = NULL;
+    unsigned int nameLength = 0;
+    int i, k;
+
+    while (pos + 20 <= size) {
+        const unsigned char *header = data + pos;
+        unsigned int type = get32(header);
+        unsigned int mrows = get32(header + 4);
+        unsigned int ncols = get32(header + 8);
+        unsigned int nameSize = get32(header + 16);
+        size_t elementSize = type % 100 / 10 == 0 ? 8 : type % 100 / 10 == 2 ? 4 : 1;
+        const unsigned char *matrix = header + 20 + nameSize;
+        if (nameSize == 0 || pos + 20 + nameSize > size) return fail("invalid MAT file", NULL);
+        pos += 20 + nameSize + (size_t)mrows * ncols * elementSize;
+        if (pos > size) return fail("invalid MAT file", NULL);
+        if (!strcmp((const char *)header + 20, "name")) {
+            names = matrix;
+            nameLength = mrows;
+            r->nColumns = (int)ncols;
+        } else if (!strcmp((const char *)header + 20, "dataInfo")) {
+            dataInfo = matrix;
+        } else if (!strcmp((const char *)header + 20, "data_2")) {
+            data2 = matrix;
+            r->nRows = (int)ncols;
+            if (names && mrows != (unsigned int)r->nColumns) return fail("data_2 does not match the names", NULL);
+        }
+    }
+    if (!names || !dataInfo || !data2) return fail("MAT file without name, dataInfo or data_2", NULL);
+    r->names = (char **)calloc(r->nColumns, sizeof(char *));
+    r->values = (double *)calloc((size_t)r->nRows * r->nColumns + 1, sizeof(double));
+    if (!r->names || !r->values) return fail("out of memory", NULL);
+    for (k = 0; k < r->nColumns; k++) {
+        const char *name = (const char *)names + (size_t)k * nameLength;
+        size_t n = nameLength;
+        int column = (int)get32(dataInfo + (4 * k + 1) * 4);
+        while (n > 0 && name[n - 1] == ' ') n--;
+        if (!(r->names[k] = copyString(name, n))) return fail("out of memory", NULL);
+        if (column < 0) column = -column;
+        if (column < 1 || column > r->nColumns) return fail("invalid dataInfo of ", r->names[k]);
+        for (i = 0; i < r->nRows; i++) {
+            r->values[i * r->nColumns + k] = getDouble(data2 + ((size_t)i * r->nColumns + column - 1) * 8);
+        }
+    }
+    return 1;
+}
+
+// a raw file: the names, then the values column by column
+static int readRaw(const unsigned char *data, size_t size, Result *r) {
+    size_t pos = 16;
+    int i, k;
+    if (size < 16) return fail("invalid raw file", NULL);
+    r->nColumns = (int)get32(data + 8);
+    r->nRows = (int)get32(data + 12);
+    r->names = (char **)calloc(r->nColumns + 1, sizeof(char *));
+    r->values = (double *)calloc((size_t)r->nRows * r->nColumns + 1, sizeof(double));
+    if (!r->names || !r->values) return fail("out of memory", NULL);
+    for (k = 0; k < r->nColumns; k++) {
+        unsigned int n;
+        if (pos + 4 > size) return fail("invalid raw file", NULL);
+        n = get32(data + pos);
+        if (pos + 4 + n > size) return fail("invalid raw file", NULL);
+        if (!(r->names[k] = copyString((const char *)data + pos + 4, n))) return fail("out of memory", NULL);
+        pos += 4 + n;
+    }
+    if (pos + (size_t)r->nRows * r->nColumns * 8 != size) return fail("invalid size of the raw file", NULL);
+    for (k = 0; k < r->nColumns; k++) {
+        for (i = 0; i < r->nRows; i++) {
+            r->values[i * r->nColumns + k] = getDouble(data + pos + ((size_t)k * r->nRows + i) * 8);
+        }
+    }
+    return 1;
+}
+
+// read the file in the format given by its content
+static int readResult(const char *path, Result *r) {
+    size_t size = 0;
+    int ok;
+    unsigned char *data = readFile(path, &size);
+    memset(r, 0, sizeof(Result));
+    if (!data) return fail("could not read ", path);
+    if (size >= 8 && !memcmp(data, "FMURAW1", 8)) {
+        ok = readRaw(data, size, r);
+    } else if (size >= 20 && get32(data) == 51 && !strcmp((const char *)data + 20, "Aclass")) {
+        ok = readMat(data, size, r);
+    } else {
+        ok = readCsv((char *)data, r);
+    }
+    free(data);
+    if (ok && (r->nColumns < 1 || strcmp(r->names[0], "time"))) ok = fail("the first column is not time in ", path);
+    return ok;
+}
+
+static int findColumn(const Result *r, const char *name) {
+    int k;
+    for (k = 0; k < r->nColumns; k++) {
+        if (!strcmp(r->names[k], name)) return k;
+    }
+    return -1;
+}
+
+static int checkSize(const Result *r, int nColumns, int nRows) {
+    if (r->nColumns != nColumns || r->nRows != nRows) {
+        printf("check_result: %d columns and %d rows, expected %d columns and %d rows\n",
+               r->nColumns, r->nRows, nColumns, nRows);
+        return 0;
+    }
+    return 1;
+}
+
+static int checkTimes(const Result *r, const double *times, int n) {
+    int i;
+    if (r->nRows != n) {
+        printf("check_result: %d rows, expected %d rows\n", r->nRows, n);
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        if (r->values[i * r->nColumns] != times[i]) {
+            printf("check_result: row %d at time %.17g, expected %.17g\n", i, r->values[i * r->nColumns], times[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int compare(const Result *r, const Result *reference, double tolerance) {
+    int i, k;
+    if (r->nRows != reference->nRows) {
+        printf("check_result: %d rows, the reference has %d rows\n", r->nRows, reference->nRows);
+        return 0;
+    }
+    for (k = 0; k < reference->nColumns; k++) {
+        int column;
+        if (reference->nRows > 0 && reference->values[k] != reference->values[k]) continue; // strings
+        column = findColumn(r, reference->names[k]);
+        if (column < 0) return fail("missing column ", reference->names[k]);
+        for (i = 0; i < r->nRows; i++) {
+            double expected = reference->values[i * reference->nColumns + k];
+            double value = r->values[i * r->nColumns + column];
+            if (!(fabs(value - expected) <= tolerance * fmax(1.0, fabs(expected)))) {
+                printf("check_result: %s is %.17g in row %d, expected %.17g\n", reference->names[k], value, i, expected);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static int usage() {
+    printf("usage: check_result size <file> <columns> <rows>\n");
+    printf("       check_result times <file> <t1,t2,...>\n");
+    printf("       check_result interval <file> <tStart> <tEnd> <interval>\n");
+    printf("       check_result compare <file> <reference file> <tolerance>\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    Result r, reference;
+    int ok;
+
+    if (argc < 3) return usage();
+    if (!readResult(argv[2], &r)) {
+        freeResult(&r);
+        return EXIT_FAILURE;
+    }
+    if (!strcmp(argv[1], "size") && argc == 5) {
+        ok = checkSize(&r, atoi(argv[3]), atoi(argv[4]));
+    } else if (!strcmp(argv[1], "times") && argc == 4) {
+        int n = 0;
+        char *p = argv[3];
+        double times[1000];
+        while (*p && n < 1000) {
+            times[n++] = strtod(p, &p);
+            if (*p == ',') p++;
+        }
+        ok = checkTimes(&r, times, n);
+    } else if (!strcmp(argv[1], "interval") && argc == 6) {
+        // the points of the output grid, see createOutputGrid() in sim_support.c
+        double tStart = strtod(argv[3], NULL);
+        double tEnd = strtod(argv[4], NULL);
+        double interval = strtod(argv[5], NULL);
+        int k, n = (int)((tEnd - tStart) / interval + 1e-9);
+        double *times = (double *)calloc(n + 1, sizeof(double));
+        ok = times != NULL;
+        if (ok) {
+            times[0] = tStart;
+            for (k = 1; k <= n; k++) times[k] = fmin(tStart + k * interval, tEnd);
+            ok = checkTimes(&r, times, n + 1);
+        }
+        free(times);
+    } else if (!strcmp(argv[1], "compare") && argc == 5) {
+        ok = readResult(argv[3], &reference) && compare(&r, &reference, strtod(argv[4], NULL));
+        freeResult(&reference);
+    } else {
+        ok = usage() == 0;
+    }
+    freeResult(&r);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}